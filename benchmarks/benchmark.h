@@ -0,0 +1,294 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// benchmark.h
+//
+// Minimal harness for the benchmarks in this directory.  It replaces the
+// global operator new to count allocations and track the live heap, so it
+// must be included by exactly one file of each benchmark program.
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdint.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+namespace benchmark {
+
+static uint64_t g_allocations = 0;
+static uint64_t g_allocatedBytes = 0;
+
+// bytes currently allocated through operator new, and the high-water mark
+// since the last ResetPeak ()
+static uint64_t g_liveBytes = 0;
+static uint64_t g_peakBytes = 0;
+
+// room in front of each allocation for its size, keeping malloc's alignment
+static const std::size_t ALLOCATION_HEADER = 16;
+
+// results are stored here so that the compiler cannot drop the work
+static volatile uint64_t g_sink = 0;
+
+static const double MIN_RUN_TIME = 0.2;  // seconds per measurement
+
+static const uint32_t MIN_SAMPLES = 100;    // timed calls per sampled measurement
+static const uint32_t MAX_SAMPLES = 10000;
+static const double MAX_SAMPLE_TIME = 1.0;  // seconds, once MIN_SAMPLES are taken
+
+inline double
+Now ()
+{
+  struct timespec now;
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+inline void
+Keep (uint64_t value)
+{
+  g_sink += value;
+}
+
+/// Whether the benchmark name matches the filter of the command line
+inline bool
+IsSelected (const std::string & name, int argc, char * argv[])
+{
+  return argc < 2 || name.find (argv[1]) != std::string::npos;
+}
+
+inline void
+PrintHeader ()
+{
+  std::printf ("%-48s %12s %12s %12s %12s\n", "benchmark", "ns/op", "B/op", "allocs/op", "wire B");
+}
+
+/**
+ * @brief Time (object.*op) () and print ns/op, allocated bytes/op and
+ *        allocations/op
+ *
+ * The iteration count doubles until a run takes MIN_RUN_TIME, after a
+ * first call that warms up caches and lazily sized buffers.
+ */
+template<class T>
+void
+Run (const std::string & name, T & object, void (T::*op) (), uint64_t wireBytes)
+{
+  (object.*op) ();
+
+  uint64_t iterations = 1;
+  for (;;) {
+    uint64_t allocations = g_allocations;
+    uint64_t allocatedBytes = g_allocatedBytes;
+    double start = Now ();
+    for (uint64_t k = 0; k < iterations; k++) {
+      (object.*op) ();
+    }
+    double elapsed = Now () - start;
+
+    if (elapsed >= MIN_RUN_TIME) {
+      std::printf ("%-48s %12.1f %12.1f %12.2f %12llu\n", name.c_str (),
+                   elapsed * 1e9 / iterations,
+                   double (g_allocatedBytes - allocatedBytes) / iterations,
+                   double (g_allocations - allocations) / iterations,
+                   (unsigned long long) wireBytes);
+      std::fflush (stdout);
+      return;
+    }
+    iterations *= 2;
+  }
+}
+
+inline void
+ResetPeak ()
+{
+  g_peakBytes = g_liveBytes;
+}
+
+inline void
+PrintSampleHeader ()
+{
+  std::printf ("%-48s %8s %10s %10s %10s %10s %12s\n",
+               "benchmark", "samples", "p50 ns", "p90 ns", "p99 ns", "max ns", "peak B");
+}
+
+/**
+ * @brief Time (object.*op) () call by call and print the latency
+ *        percentiles and the peak heap growth of a single call
+ *
+ * For operations whose cost depends on the state they leave behind, or on
+ * an argument op picks itself, so that a mean would hide the tail.  Calls
+ * are taken until maxSamples, or MAX_SAMPLE_TIME once there are
+ * MIN_SAMPLES.  Peak B is the largest amount of heap above the level at
+ * the start of a call that was live at any point during it.
+ */
+template<class T>
+void
+RunSampled (const std::string & name, T & object, void (T::*op) (),
+            uint32_t maxSamples = MAX_SAMPLES)
+{
+  (object.*op) ();
+
+  std::vector<double> samples;
+  samples.reserve (maxSamples);
+  uint64_t peak = 0;
+
+  double start = Now ();
+  while (samples.size () < maxSamples &&
+         (samples.size () < MIN_SAMPLES || Now () - start < MAX_SAMPLE_TIME)) {
+    uint64_t live = g_liveBytes;
+    ResetPeak ();
+    double callStart = Now ();
+    (object.*op) ();
+    double elapsed = Now () - callStart;
+    samples.push_back (elapsed);
+    peak = std::max (peak, g_peakBytes - live);
+  }
+
+  std::sort (samples.begin (), samples.end ());
+  uint32_t n = samples.size ();
+  std::printf ("%-48s %8u %10.0f %10.0f %10.0f %10.0f %12llu\n", name.c_str (), n,
+               samples[n * 50 / 100] * 1e9,
+               samples[n * 90 / 100] * 1e9,
+               samples[n * 99 / 100] * 1e9,
+               samples[n - 1] * 1e9,
+               (unsigned long long) peak);
+  std::fflush (stdout);
+}
+
+// counted allocation behind every form of operator new: 0 if malloc fails
+static void *
+Allocate (std::size_t size)
+{
+  char * p = static_cast<char *> (std::malloc (ALLOCATION_HEADER + size));
+  if (p == 0) {
+    return 0;
+  }
+  g_allocations++;
+  g_allocatedBytes += size;
+  g_liveBytes += size;
+  g_peakBytes = std::max (g_peakBytes, g_liveBytes);
+  std::memcpy (p, &size, sizeof (size));
+  return p + ALLOCATION_HEADER;
+}
+
+static void
+Deallocate (void * p)
+{
+  if (p == 0) {
+    return;
+  }
+  char * block = static_cast<char *> (p) - ALLOCATION_HEADER;
+  std::size_t size;
+  std::memcpy (&size, block, sizeof (size));
+  g_liveBytes -= size;
+  std::free (block);
+}
+
+} // namespace benchmark
+
+// All the forms are replaced: the library's own nothrow and array forms
+// would otherwise hand blocks without our header to our operator delete
+// (older libstdc++ allocates the nothrow form with malloc directly, as
+// std::get_temporary_buffer under std::stable_sort does).  C++14 adds the
+// sized deletes, and C++17 rejects dynamic exception specifications.
+
+#if __cplusplus >= 201103L
+#define BENCHMARK_THROW_BAD_ALLOC noexcept (false)
+#define BENCHMARK_NOTHROW noexcept
+#else
+#define BENCHMARK_THROW_BAD_ALLOC throw (std::bad_alloc)
+#define BENCHMARK_NOTHROW throw ()
+#endif
+
+void *
+operator new (std::size_t size) BENCHMARK_THROW_BAD_ALLOC
+{
+  void * p = benchmark::Allocate (size);
+  if (p == 0) {
+    throw std::bad_alloc ();
+  }
+  return p;
+}
+
+void *
+operator new[] (std::size_t size) BENCHMARK_THROW_BAD_ALLOC
+{
+  return operator new (size);
+}
+
+void *
+operator new (std::size_t size, const std::nothrow_t &) BENCHMARK_NOTHROW
+{
+  return benchmark::Allocate (size);
+}
+
+void *
+operator new[] (std::size_t size, const std::nothrow_t &) BENCHMARK_NOTHROW
+{
+  return benchmark::Allocate (size);
+}
+
+void
+operator delete (void * p) BENCHMARK_NOTHROW
+{
+  benchmark::Deallocate (p);
+}
+
+void
+operator delete[] (void * p) BENCHMARK_NOTHROW
+{
+  benchmark::Deallocate (p);
+}
+
+void
+operator delete (void * p, const std::nothrow_t &) BENCHMARK_NOTHROW
+{
+  benchmark::Deallocate (p);
+}
+
+void
+operator delete[] (void * p, const std::nothrow_t &) BENCHMARK_NOTHROW
+{
+  benchmark::Deallocate (p);
+}
+
+void
+operator delete (void * p, std::size_t) BENCHMARK_NOTHROW
+{
+  operator delete (p);
+}
+
+void
+operator delete[] (void * p, std::size_t) BENCHMARK_NOTHROW
+{
+  operator delete[] (p);
+}
+
+#undef BENCHMARK_THROW_BAD_ALLOC
+#undef BENCHMARK_NOTHROW
+
+#endif /* BENCHMARK_H */
@@ -0,0 +1,184 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// codec-bench.cc
+
+#include "benchmark.h"
+#include "nlsr-lsu.h"
+#include "nlsr-tlv.h"
+#include "ns3/buffer.h"
+
+#include <algorithm>
+#include <sstream>
+
+using namespace ns3;
+using namespace ns3::ndn;
+
+/**
+ * Encode and decode cost of the NLSR headers, without a simulation:
+ *
+ *   ./waf --run "codec-bench [filter]"
+ *
+ * For every header, encoding, number of tuples (10 to 10000) and name
+ * length (10 to 200 bytes) it times
+ *
+ *   size    GetSerializedSize of a freshly changed header
+ *   encode  GetSerializedSize then Serialize, as Packet::AddHeader does
+ *   decode  Deserialize into a new header
+ *
+ * and prints ns/op, bytes allocated/op and allocations/op.  The optional
+ * filter selects the benchmarks whose name contains it, e.g. "lsu/".
+ */
+
+namespace {
+
+const uint32_t TUPLE_COUNTS[] = {10, 100, 1000, 10000};
+const uint32_t NAME_LENGTHS[] = {10, 50, 200};
+
+// a name of exactly length bytes, unique for k, that shares its leading
+// components with the names of nearby k the way router prefixes do
+std::string
+MakeName (uint32_t k, uint32_t length)
+{
+  std::ostringstream os;
+  os << "/net/site-" << k / 16 << "/router-" << k;
+  std::string name = os.str ();
+  if (name.size () >= length) {
+    return name.substr (name.size () - length);
+  }
+  while (name.size () < length) {
+    name += "/pad";
+  }
+  name.resize (length);
+  return name;
+}
+
+// the three operations on a header that is serialized once up front
+template<class H>
+class CodecBenchmark {
+
+public:
+  CodecBenchmark (const H & message, uint8_t encoding)
+  : m_message (message), m_encoding (encoding)
+  {
+    m_message.SetEncoding (m_encoding);
+    m_buffer.AddAtStart (m_message.GetSerializedSize ());
+    m_message.Serialize (m_buffer.Begin ());
+  }
+
+  uint32_t
+  GetWireSize () const
+  {
+    return m_buffer.GetSize ();
+  }
+
+  void
+  Size ()
+  {
+    m_message.SetEncoding (m_encoding);  // drops the cached size
+    benchmark::Keep (m_message.GetSerializedSize ());
+  }
+
+  void
+  Encode ()
+  {
+    m_message.SetEncoding (m_encoding);
+    benchmark::Keep (m_message.GetSerializedSize ());
+    m_message.Serialize (m_buffer.Begin ());
+  }
+
+  void
+  Decode ()
+  {
+    H message;
+    benchmark::Keep (message.Deserialize (m_buffer.Begin ()));
+  }
+
+private:
+  H m_message;
+  uint8_t m_encoding;
+  Buffer m_buffer;
+};
+
+template<class H>
+void
+RunCodec (const std::string & name, const H & message, uint8_t encoding, int argc, char * argv[])
+{
+  if (!benchmark::IsSelected (name + "/", argc, argv)) {
+    return;
+  }
+  CodecBenchmark<H> codec (message, encoding);
+  benchmark::Run (name + "/size", codec, &CodecBenchmark<H>::Size, codec.GetWireSize ());
+  benchmark::Run (name + "/encode", codec, &CodecBenchmark<H>::Encode, codec.GetWireSize ());
+  benchmark::Run (name + "/decode", codec, &CodecBenchmark<H>::Decode, codec.GetWireSize ());
+}
+
+std::string
+MakeLabel (const char * header, const char * encoding, uint32_t tuples, uint32_t length)
+{
+  std::ostringstream os;
+  os << header << "/" << encoding << "/n=" << tuples << "/len=" << length;
+  return os.str ();
+}
+
+} // anonymous namespace
+
+int
+main (int argc, char *argv[])
+{
+  benchmark::PrintHeader ();
+
+  for (uint32_t t = 0; t < sizeof (TUPLE_COUNTS) / sizeof (TUPLE_COUNTS[0]); t++) {
+    for (uint32_t l = 0; l < sizeof (NAME_LENGTHS) / sizeof (NAME_LENGTHS[0]); l++) {
+      uint32_t tuples = TUPLE_COUNTS[t];
+      uint32_t length = NAME_LENGTHS[l];
+
+      LsuContent lsu;
+      lsu.SetLifetime (86400);
+      for (uint32_t k = 0; k < tuples; k++) {
+        lsu.AddAdjacency (MakeName (k, length), k % 100 + 1);
+        lsu.AddReachability (MakeName (k + tuples, length), k % 10 + 1);
+      }
+      RunCodec (MakeLabel ("lsu", "legacy", tuples, length), lsu, tlv::LEGACY_ENCODING, argc, argv);
+      RunCodec (MakeLabel ("lsu", "varnum", tuples, length), lsu, tlv::VARNUM_ENCODING, argc, argv);
+
+      std::vector<std::string> sorted;
+      for (uint32_t k = 0; k < tuples; k++) {
+        sorted.push_back (MakeName (k, length));
+      }
+      std::sort (sorted.begin (), sorted.end ());
+      NameListHeader names;
+      names.Swap (sorted);
+      RunCodec (MakeLabel ("names", "legacy", tuples, length), names, tlv::LEGACY_ENCODING, argc, argv);
+      RunCodec (MakeLabel ("names", "front-coded", tuples, length), names, tlv::FRONT_CODED_ENCODING, argc, argv);
+
+      HelloData hello;
+      hello.SetRouterName (MakeName (tuples, length));
+      hello.SetDeadTime (40);
+      hello.SetVersion (1);
+      for (uint32_t k = 0; k < tuples; k++) {
+        hello.AddNeighborList (MakeName (k, length));
+      }
+      RunCodec (MakeLabel ("hello", "legacy", tuples, length), hello, tlv::LEGACY_ENCODING, argc, argv);
+      RunCodec (MakeLabel ("hello", "varnum", tuples, length), hello, tlv::VARNUM_ENCODING, argc, argv);
+    }
+  }
+  return 0;
+}
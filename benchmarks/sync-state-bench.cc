@@ -0,0 +1,232 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// sync-state-bench.cc
+
+#include "benchmark.h"
+#include "sync-state.h"
+
+#include <sstream>
+
+using namespace ns3;
+using namespace ns3::ndn;
+
+/**
+ * Cost of the SyncState operations as the digest log fills up, without a
+ * simulation:
+ *
+ *   ./waf --run "sync-state-bench [filter]"
+ *
+ * For 1k, 10k and 100k ids, the state is loaded with one name per id and
+ * then fed single-name updates of random ids until the digest log holds a
+ * quarter, half or all of DEFAULT_MAX_LOG_LENGTH entries.  On that state
+ * it times, call by call,
+ *
+ *   in-log       IsDigestInLog, half of them for digests in the log
+ *   sync-digest  GetSyncDigest; no digest is counted, so it walks the whole log
+ *   inbetween    GetUpdateInbetween from a random logged digest to the current one
+ *   by-then      GetUpdateInbetween from INITIAL_DIGEST, i.e. GetUpdateByThen,
+ *                to a random logged digest
+ *   update       Update (id, seq) with the next seq of a random id
+ *
+ * and prints the latency percentiles and the peak heap growth of a call,
+ * after a line with the heap the loaded state holds.  update runs last as
+ * it moves the state; below a full log it is sampled less so that the log
+ * grows by at most 5%.  The optional filter selects the benchmarks whose
+ * name contains it, e.g. "ids=100000/".
+ */
+
+namespace {
+
+const uint32_t ID_COUNTS[] = {1000, 10000, 100000};
+const uint32_t LOG_FILLS[] = {4, 2, 1};  // log depth is DEFAULT_MAX_LOG_LENGTH / fill
+
+const uint32_t LOAD_BATCH = 1000;  // names per Update while loading the ids
+
+// a router/unit id the way the scenarios name them
+std::string
+MakeId (uint32_t k)
+{
+  std::ostringstream os;
+  os << "/net/site-" << k / 16 << "/router-" << k;
+  return os.str ();
+}
+
+class SyncStateBenchmark {
+
+public:
+  SyncStateBenchmark (uint32_t idCount, uint32_t logDepth)
+  : m_seqs (idCount, 1), m_calls (0)
+  {
+    std::srand (idCount + logDepth);
+
+    // room for every update the benchmarks make, so that growing it does
+    // not show up in the peak heap of update
+    m_digests.reserve (logDepth + benchmark::MAX_SAMPLES + 2);
+    m_ids.reserve (idCount);
+    for (uint32_t k = 0; k < idCount; k++) {
+      m_ids.push_back (MakeId (k));
+    }
+
+    uint64_t live = benchmark::g_liveBytes;
+    NameList nameList;
+    for (uint32_t k = 0; k < idCount; k++) {
+      std::string name;
+      SyncState::IdSeqToName (m_ids[k], 1, name);
+      nameList.push_back (name);
+      if (nameList.size () == LOAD_BATCH || k + 1 == idCount) {
+        m_state.Update (nameList);
+        nameList.clear ();
+      }
+    }
+    for (uint32_t k = 0; k < logDepth; k++) {
+      Advance ();
+    }
+    m_stateBytes = benchmark::g_liveBytes - live;
+
+    // the loading batches, and anything else evicted, cannot be asked for
+    std::vector<uint64_t> logged;
+    logged.reserve (m_digests.capacity ());
+    for (std::vector<uint64_t>::const_iterator i = m_digests.begin ();
+         i != m_digests.end ();
+         i++)
+    {
+      if (m_state.IsDigestInLog (*i)) {
+        logged.push_back (*i);
+      }
+    }
+    m_digests.swap (logged);
+  }
+
+  uint64_t
+  GetStateBytes () const
+  {
+    return m_stateBytes;
+  }
+
+  void
+  InLog ()
+  {
+    uint64_t digest = RandomDigest ();
+    if (m_calls++ % 2 == 1) {
+      digest = ~digest;
+    }
+    benchmark::Keep (m_state.IsDigestInLog (digest));
+  }
+
+  void
+  SyncDigest ()
+  {
+    benchmark::Keep (m_state.GetSyncDigest ());
+  }
+
+  void
+  Inbetween ()
+  {
+    NameList nameList;
+    m_state.GetUpdateInbetween (RandomDigest (), m_state.GetCurrentDigest (), nameList);
+    benchmark::Keep (nameList.size ());
+  }
+
+  void
+  ByThen ()
+  {
+    NameList nameList;
+    m_state.GetUpdateInbetween (INITIAL_DIGEST, RandomDigest (), nameList);
+    benchmark::Keep (nameList.size ());
+  }
+
+  void
+  Update ()
+  {
+    Advance ();
+  }
+
+private:
+  void
+  Advance ()
+  {
+    uint32_t k = Random () % m_ids.size ();
+    m_state.Update (m_ids[k], ++m_seqs[k]);
+    m_digests.push_back (m_state.GetCurrentDigest ());
+  }
+
+  uint64_t
+  RandomDigest () const
+  {
+    return m_digests[Random () % m_digests.size ()];
+  }
+
+  static uint32_t
+  Random ()
+  {
+    // rand () alone may only reach 32767
+    return (uint32_t (std::rand ()) << 15) ^ uint32_t (std::rand ());
+  }
+
+private:
+  SyncState m_state;
+  std::vector<std::string> m_ids;
+  std::vector<uint64_t> m_seqs;
+  std::vector<uint64_t> m_digests;  // digests the updates produced, oldest first
+  uint64_t m_stateBytes;
+  uint32_t m_calls;
+};
+
+std::string
+MakeLabel (uint32_t ids, uint32_t depth)
+{
+  std::ostringstream os;
+  os << "ids=" << ids << "/log=" << depth << "/";
+  return os.str ();
+}
+
+} // anonymous namespace
+
+int
+main (int argc, char *argv[])
+{
+  benchmark::PrintSampleHeader ();
+
+  for (uint32_t n = 0; n < sizeof (ID_COUNTS) / sizeof (ID_COUNTS[0]); n++) {
+    for (uint32_t f = 0; f < sizeof (LOG_FILLS) / sizeof (LOG_FILLS[0]); f++) {
+      uint32_t ids = ID_COUNTS[n];
+      uint32_t depth = DEFAULT_MAX_LOG_LENGTH / LOG_FILLS[f];
+      std::string label = MakeLabel (ids, depth);
+      if (!benchmark::IsSelected (label, argc, argv)) {
+        continue;
+      }
+
+      SyncStateBenchmark bench (ids, depth);
+      std::printf ("%-48s %8s %10s %10s %10s %10s %12llu\n", (label + "state").c_str (),
+                   "-", "-", "-", "-", "-", (unsigned long long) bench.GetStateBytes ());
+
+      benchmark::RunSampled (label + "in-log", bench, &SyncStateBenchmark::InLog);
+      benchmark::RunSampled (label + "sync-digest", bench, &SyncStateBenchmark::SyncDigest);
+      benchmark::RunSampled (label + "inbetween", bench, &SyncStateBenchmark::Inbetween);
+      benchmark::RunSampled (label + "by-then", bench, &SyncStateBenchmark::ByThen);
+
+      uint32_t updates = depth < DEFAULT_MAX_LOG_LENGTH ?
+                         std::max (benchmark::MIN_SAMPLES, depth / 20) : benchmark::MAX_SAMPLES;
+      benchmark::RunSampled (label + "update", bench, &SyncStateBenchmark::Update, updates);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,70 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// name-span.h
+
+#ifndef _NAME_SPAN_H
+#define _NAME_SPAN_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace ndn {
+
+/**
+ * @brief Read-only (pointer, length) view of a name inside a receive buffer
+ *
+ * Produced by the view parsers of nlsr-lsu.h; it stays valid only as long
+ * as the buffer it was parsed from is neither freed nor overwritten.
+ */
+struct NameSpan
+{
+  const char * data;
+  uint32_t size;
+
+  NameSpan ()
+  : data (0), size (0)
+  {}
+
+  NameSpan (const char * d, uint32_t s)
+  : data (d), size (s)
+  {}
+
+  std::string
+  ToString () const
+  {
+    return std::string (data, size);
+  }
+
+  bool
+  operator== (const std::string & name) const
+  {
+    return size == name.size () && name.compare (0, name.size (), data, size) == 0;
+  }
+};
+
+typedef std::vector<NameSpan> NameSpanList;
+
+} // namespace ndn
+} // namespace ns3
+
+#endif /* _NAME_SPAN_H */
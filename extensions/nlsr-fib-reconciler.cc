@@ -0,0 +1,250 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// nlsr-fib-reconciler.cc
+
+#include "nlsr-fib-reconciler.h"
+#include "ns3/assert.h"
+#include "ns3/log.h"
+#include "ns3/ndn-fib-entry.h"
+#include "ns3/ndn-name.h"
+#include "ns3/trace-source-accessor.h"
+
+NS_LOG_COMPONENT_DEFINE ("FibReconciler");
+
+namespace ns3 {
+namespace ndn {
+
+// ========== Class FibReconciler ============
+
+NS_OBJECT_ENSURE_REGISTERED (FibReconciler);
+
+const FibReconciler::NodeIndex FibReconciler::ROOT;
+const FibReconciler::NodeIndex FibReconciler::NO_NODE;
+
+FibReconciler::FibReconciler ()
+  : m_nodes (1)
+  , m_size (0)
+  , m_added (0)
+  , m_removed (0)
+  , m_updated (0)
+{
+  m_nodes[ROOT].parent = NO_NODE;
+}
+
+FibReconciler::~FibReconciler ()
+{
+}
+
+TypeId
+FibReconciler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("FibReconciler")
+    .SetParent<Object> ()
+    .AddConstructor<FibReconciler> ()
+    .AddTraceSource ("Diff", "Faces added, faces removed and metrics updated in the Fib by a routing event",
+                     MakeTraceSourceAccessor (&FibReconciler::m_diff))
+    ;
+  return tid;
+}
+
+void
+FibReconciler::DoDispose ()
+{
+  m_fib = 0;
+  m_nodes.clear ();
+  Object::DoDispose ();
+}
+
+void
+FibReconciler::SetFib (Ptr<Fib> fib)
+{
+  m_fib = fib;
+}
+
+uint32_t
+FibReconciler::SetNextHops (const std::string & prefix, const NextHopSet & nextHops)
+{
+  NodeIndex node = nextHops.empty () ? FindNode (prefix) : InsertNode (prefix);
+  if (node == NO_NODE || (nextHops.empty () && m_nodes[node].nextHops.empty ())) {
+    return 0;
+  }
+  NextHopSet & installed = m_nodes[node].nextHops;
+  Name name (prefix);
+
+  if (nextHops.empty ()) {
+    uint32_t removed = installed.size ();
+    NS_LOG_DEBUG ("Remove " << prefix << ": " << removed << " faces");
+    if (m_fib != 0) {
+      m_fib->Remove (Create<Name> (name));
+    }
+    m_removed += removed;
+    m_size--;
+    installed.clear ();
+    Prune (node);
+    return removed;
+  }
+
+  // both sets are ordered by face: walk them side by side
+  uint32_t operations = 0;
+  Ptr<fib::Entry> entry;
+  if (installed.empty ()) {
+    m_size++;
+  }
+  NextHopSet::const_iterator n = nextHops.begin ();
+  NextHopSet::const_iterator i = installed.begin ();
+  while (n != nextHops.end () || i != installed.end ()) {
+    if (i == installed.end () || (n != nextHops.end () && n->first < i->first)) {
+      NS_LOG_DEBUG ("Add " << prefix << ": face " << n->first->GetId () << " metric " << n->second);
+      if (m_fib != 0) {
+        m_fib->Add (name, n->first, n->second);
+      }
+      m_added++;
+      operations++;
+      n++;
+    } else if (n == nextHops.end () || i->first < n->first) {
+      NS_LOG_DEBUG ("Remove " << prefix << ": face " << i->first->GetId ());
+      if (m_fib != 0) {
+        if (entry == 0) {
+          entry = m_fib->Find (name);
+        }
+        if (entry != 0) {
+          entry->RemoveFace (i->first);
+        }
+      }
+      m_removed++;
+      operations++;
+      i++;
+    } else {
+      if (n->second != i->second) {
+        NS_LOG_DEBUG ("Update " << prefix << ": face " << n->first->GetId () << " metric " << n->second);
+        if (m_fib != 0) {
+          m_fib->Add (name, n->first, n->second);
+        }
+        m_updated++;
+        operations++;
+      }
+      n++;
+      i++;
+    }
+  }
+  installed = nextHops;
+  return operations;
+}
+
+const NextHopSet *
+FibReconciler::GetNextHops (const std::string & prefix) const
+{
+  NodeIndex node = FindNode (prefix);
+  if (node == NO_NODE || m_nodes[node].nextHops.empty ()) {
+    return 0;
+  }
+  return &m_nodes[node].nextHops;
+}
+
+uint32_t
+FibReconciler::GetSize () const
+{
+  return m_size;
+}
+
+void
+FibReconciler::Commit ()
+{
+  m_diff (m_added, m_removed, m_updated);
+  m_added = 0;
+  m_removed = 0;
+  m_updated = 0;
+}
+
+void
+FibReconciler::SplitName (const std::string & prefix, std::vector<std::string> & components)
+{
+  components.clear ();
+  size_t begin = 0;
+  while (begin < prefix.size ()) {
+    size_t end = prefix.find ('/', begin);
+    if (end == std::string::npos) {
+      end = prefix.size ();
+    }
+    if (end > begin) {
+      components.push_back (prefix.substr (begin, end - begin));
+    }
+    begin = end + 1;
+  }
+}
+
+FibReconciler::NodeIndex
+FibReconciler::FindNode (const std::string & prefix) const
+{
+  std::vector<std::string> components;
+  SplitName (prefix, components);
+  NodeIndex node = ROOT;
+  for (std::vector<std::string>::const_iterator c = components.begin (); c != components.end (); c++) {
+    std::map<std::string, NodeIndex>::const_iterator child = m_nodes[node].children.find (*c);
+    if (child == m_nodes[node].children.end ()) {
+      return NO_NODE;
+    }
+    node = child->second;
+  }
+  return node;
+}
+
+FibReconciler::NodeIndex
+FibReconciler::InsertNode (const std::string & prefix)
+{
+  SplitName (prefix, m_components);
+  NodeIndex node = ROOT;
+  for (std::vector<std::string>::const_iterator c = m_components.begin (); c != m_components.end (); c++) {
+    std::map<std::string, NodeIndex>::const_iterator child = m_nodes[node].children.find (*c);
+    if (child != m_nodes[node].children.end ()) {
+      node = child->second;
+      continue;
+    }
+    NodeIndex created;
+    if (m_free.empty ()) {
+      created = m_nodes.size ();
+      m_nodes.push_back (TrieNode ());
+    } else {
+      created = m_free.back ();
+      m_free.pop_back ();
+    }
+    m_nodes[created].parent = node;
+    m_nodes[created].component = *c;
+    m_nodes[node].children[*c] = created;
+    node = created;
+  }
+  return node;
+}
+
+void
+FibReconciler::Prune (NodeIndex node)
+{
+  while (node != ROOT && m_nodes[node].nextHops.empty () && m_nodes[node].children.empty ()) {
+    NodeIndex parent = m_nodes[node].parent;
+    m_nodes[parent].children.erase (m_nodes[node].component);
+    m_nodes[node].component.clear ();
+    m_free.push_back (node);
+    node = parent;
+  }
+}
+
+} // namespace ndn
+} // namespace ns3
@@ -0,0 +1,138 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// nlsr-fib-reconciler.h
+
+#ifndef NLSR_FIB_RECONCILER_H
+#define NLSR_FIB_RECONCILER_H
+
+#include "ns3/object.h"
+#include "ns3/ndn-face.h"
+#include "ns3/ndn-fib.h"
+#include "ns3/traced-callback.h"
+
+#include <map>
+#include <vector>
+
+namespace ns3 {
+namespace ndn {
+
+typedef std::map<Ptr<Face>, int32_t> NextHopSet;  // face -> routing metric
+
+// ========== Class FibReconciler ============
+
+/**
+ * @brief The next hops the routing computation installed into the Fib,
+ *        per prefix, so that a new route costs only its difference
+ *
+ * SetNextHops compares the new next hops of a prefix with the installed
+ * ones and applies just the faces that were added or removed and the
+ * metrics that changed; a prefix left with no next hop has its Fib entry
+ * removed.  The installed sets are kept in a trie over the components of
+ * the prefix names.  The operations applied between two Commit calls, one
+ * routing event, are reported through the Diff trace source.
+ */
+class FibReconciler : public Object {
+
+public:
+  FibReconciler ();
+  virtual ~FibReconciler ();
+
+  static TypeId
+  GetTypeId (void);
+
+  /// Without a Fib only the installed sets are kept
+  void
+  SetFib (Ptr<Fib> fib);
+
+  /**
+   * @brief Make nextHops the next hops of prefix in the Fib
+   *
+   * @returns the number of Fib operations it took
+   */
+  uint32_t
+  SetNextHops (const std::string & prefix, const NextHopSet & nextHops);
+
+  /// @returns 0 if prefix has no next hop installed
+  const NextHopSet *
+  GetNextHops (const std::string & prefix) const;
+
+  /// Number of prefixes with next hops installed
+  uint32_t
+  GetSize () const;
+
+  /// End of a routing event: report its operations through Diff
+  void
+  Commit ();
+
+protected:
+  virtual void
+  DoDispose ();
+
+private:
+  typedef uint32_t NodeIndex;
+
+  struct TrieNode
+  {
+    std::map<std::string, NodeIndex> children;  // by name component
+    NodeIndex parent;
+    std::string component;
+    NextHopSet nextHops;  // empty if no route ends here
+  };
+
+  static const NodeIndex ROOT = 0;
+  static const NodeIndex NO_NODE = 0xFFFFFFFF;
+
+  static void
+  SplitName (const std::string & prefix, std::vector<std::string> & components);
+
+  /// NO_NODE if the trie has no node for prefix
+  NodeIndex
+  FindNode (const std::string & prefix) const;
+
+  /// Node of prefix, created on the way
+  NodeIndex
+  InsertNode (const std::string & prefix);
+
+  /// Drop node and the ancestors left without routes or children
+  void
+  Prune (NodeIndex node);
+
+private:
+  Ptr<Fib> m_fib;
+  std::vector<TrieNode> m_nodes;   // m_nodes[ROOT] is the empty name
+  std::vector<NodeIndex> m_free;   // released entries of m_nodes
+  uint32_t m_size;
+  std::vector<std::string> m_components;  // scratch of InsertNode
+
+  // operations since the last Commit
+  uint32_t m_added;
+  uint32_t m_removed;
+  uint32_t m_updated;
+
+  // faces added, faces removed, metrics updated
+  TracedCallback<uint32_t, uint32_t, uint32_t> m_diff;
+
+}; // class FibReconciler
+
+} // namespace ndn
+} // namespace ns3
+
+#endif // NLSR_FIB_RECONCILER_H
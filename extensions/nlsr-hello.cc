@@ -0,0 +1,274 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// nlsr-hello.cc
+
+#include "nlsr-hello.h"
+#include "ns3/assert.h"
+#include "ns3/log.h"
+#include "ns3/packet.h"
+#include "ns3/simulator.h"
+#include "ns3/uinteger.h"
+#include "ns3/trace-source-accessor.h"
+
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("HelloProtocol");
+
+namespace ns3 {
+namespace ndn {
+
+// ========== Class HelloProtocol ============
+
+NS_OBJECT_ENSURE_REGISTERED (HelloProtocol);
+
+HelloProtocol::HelloProtocol ()
+  : m_helloInterval (Seconds (DEFAULT_HELLO_INTERVAL))
+  , m_deadTime (DEFAULT_DEAD_TIME)
+  , m_helloSeq (0)
+{
+}
+
+HelloProtocol::~HelloProtocol ()
+{
+}
+
+TypeId
+HelloProtocol::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("HelloProtocol")
+    .SetParent<Object> ()
+    .AddConstructor<HelloProtocol> ()
+    .AddAttribute ("HelloInterval", "Time between the hellos to each neighbor",
+                   TimeValue (Seconds (DEFAULT_HELLO_INTERVAL)),
+                   MakeTimeAccessor (&HelloProtocol::SetHelloInterval, &HelloProtocol::GetHelloInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("DeadTime", "Seconds without a hello after which the neighbors take us for dead",
+                   UintegerValue (DEFAULT_DEAD_TIME),
+                   MakeUintegerAccessor (&HelloProtocol::SetDeadTime, &HelloProtocol::GetDeadTime),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddTraceSource ("AdjacencyChanged", "A neighbor came up or went down",
+                     MakeTraceSourceAccessor (&HelloProtocol::m_adjacencyTrace))
+    ;
+  return tid;
+}
+
+void
+HelloProtocol::DoDispose ()
+{
+  Stop ();
+  m_neighbors.clear ();
+  m_sendInterest = SendInterestCallback ();
+  m_sendData = SendDataCallback ();
+  m_adjacencyChanged = AdjacencyCallback ();
+  m_getDigest = DigestCallback ();
+  m_neighborDigest = NeighborDigestCallback ();
+  Object::DoDispose ();
+}
+
+void
+HelloProtocol::SetRouterName (const std::string & routerName)
+{
+  m_routerName = routerName;
+}
+
+void
+HelloProtocol::SetSendCallbacks (SendInterestCallback sendInterest, SendDataCallback sendData)
+{
+  m_sendInterest = sendInterest;
+  m_sendData = sendData;
+}
+
+void
+HelloProtocol::SetAdjacencyCallback (AdjacencyCallback adjacencyChanged)
+{
+  m_adjacencyChanged = adjacencyChanged;
+}
+
+void
+HelloProtocol::SetDigestCallbacks (DigestCallback getDigest, NeighborDigestCallback neighborDigest)
+{
+  m_getDigest = getDigest;
+  m_neighborDigest = neighborDigest;
+}
+
+void
+HelloProtocol::AddNeighbor (const std::string & neighbor)
+{
+  m_neighbors[neighbor];
+}
+
+void
+HelloProtocol::Start ()
+{
+  Simulator::Cancel (m_helloEvent);
+  m_helloEvent = Simulator::ScheduleNow (&HelloProtocol::SendHellos, this);
+}
+
+void
+HelloProtocol::Stop ()
+{
+  Simulator::Cancel (m_helloEvent);
+  for (NeighborMap::iterator i = m_neighbors.begin (); i != m_neighbors.end (); i++) {
+    Simulator::Cancel (i->second.deadEvent);
+  }
+}
+
+bool
+HelloProtocol::IsHelloName (Ptr<const Name> name)
+{
+  return name->size () == HELLO_PREFIX_SIZE + 3 &&
+         name->getPrefix (HELLO_PREFIX_SIZE).toUri ().compare (HELLO_PREFIX) == 0;
+}
+
+void
+HelloProtocol::OnHelloInterest (Ptr<const Interest> interest)
+{
+  if (interest->GetNamePtr ()->get (HELLO_PREFIX_SIZE).toUri () != m_routerName) {
+    return;
+  }
+
+  HelloData hello;
+  hello.SetRouterName (m_routerName);
+  hello.SetDeadTime (m_deadTime);
+  hello.SetVersion (HELLO_VERSION);
+  if (!m_getDigest.IsNull ()) {
+    hello.SetDigest (m_getDigest ());
+  }
+  for (NeighborMap::const_iterator i = m_neighbors.begin (); i != m_neighbors.end (); i++) {
+    if (i->second.heard) {
+      hello.AddNeighborList (i->first);
+    }
+  }
+
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (hello);
+  Ptr<Data> data = Create<Data> (packet);
+  data->SetName (Create<Name> (interest->GetName ()));
+  m_sendData (data);
+}
+
+void
+HelloProtocol::OnHelloData (Ptr<const Data> data)
+{
+  // parsed in place from a flat copy, so that a malformed hello is dropped
+  Ptr<const Packet> payload = data->GetPayload ();
+  m_rxBuffer.resize (std::max<uint32_t> (payload->GetSize (), 1));
+  uint32_t size = payload->CopyData (&m_rxBuffer[0], payload->GetSize ());
+  if (m_rxHello.Parse (&m_rxBuffer[0], size) == false) {
+    NS_LOG_DEBUG ("Malformed hello: " << data->GetName ());
+    return;
+  }
+  if (m_rxHello.GetVersion () != HELLO_VERSION) {
+    NS_LOG_DEBUG ("Hello of version " << (uint32_t) m_rxHello.GetVersion ());
+    return;
+  }
+  std::string routerName = m_rxHello.GetRouterName ().ToString ();
+  NeighborMap::iterator i = m_neighbors.find (routerName);
+  if (i == m_neighbors.end ()) {
+    NS_LOG_DEBUG ("Hello from a router on none of our links: " << routerName);
+    return;
+  }
+
+  Neighbor & neighbor = i->second;
+  neighbor.heard = true;
+  Simulator::Cancel (neighbor.deadEvent);
+  neighbor.deadEvent = Simulator::Schedule (Seconds (m_rxHello.GetDeadTime ()), &HelloProtocol::OnDeadTime, this, i->first);
+
+  const NameSpanList & heard = m_rxHello.GetNeighborList ();
+  SetUp (i->first, neighbor, std::find (heard.begin (), heard.end (), m_routerName) != heard.end ());
+
+  if (neighbor.up && m_rxHello.GetDigest () != 0 && !m_neighborDigest.IsNull ()) {
+    m_neighborDigest (i->first, m_rxHello.GetDigest ());
+  }
+}
+
+bool
+HelloProtocol::IsUp (const std::string & neighbor) const
+{
+  NeighborMap::const_iterator i = m_neighbors.find (neighbor);
+  return i != m_neighbors.end () && i->second.up;
+}
+
+Time
+HelloProtocol::GetHelloInterval () const
+{
+  return m_helloInterval;
+}
+
+void
+HelloProtocol::SetHelloInterval (Time interval)
+{
+  NS_ASSERT (interval.IsStrictlyPositive ());
+  m_helloInterval = interval;
+}
+
+uint32_t
+HelloProtocol::GetDeadTime () const
+{
+  return m_deadTime;
+}
+
+void
+HelloProtocol::SetDeadTime (uint32_t deadTime)
+{
+  m_deadTime = deadTime;
+}
+
+void
+HelloProtocol::SendHellos ()
+{
+  for (NeighborMap::const_iterator i = m_neighbors.begin (); i != m_neighbors.end (); i++) {
+    Ptr<Name> name = Create<Name> (HELLO_PREFIX);
+    name->append (i->first);
+    name->append (m_routerName);
+    name->appendNumber (++m_helloSeq);
+    NS_LOG_DEBUG ("Hello to " << i->first);
+    m_sendInterest (name, m_helloInterval);
+  }
+  m_helloEvent = Simulator::Schedule (m_helloInterval, &HelloProtocol::SendHellos, this);
+}
+
+void
+HelloProtocol::OnDeadTime (std::string neighbor)
+{
+  NeighborMap::iterator i = m_neighbors.find (neighbor);
+  NS_ASSERT (i != m_neighbors.end ());
+  NS_LOG_DEBUG ("Dead time of " << neighbor << " passed");
+  i->second.heard = false;
+  SetUp (neighbor, i->second, false);
+}
+
+void
+HelloProtocol::SetUp (const std::string & neighbor, Neighbor & state, bool up)
+{
+  if (state.up == up) {
+    return;
+  }
+  state.up = up;
+  NS_LOG_DEBUG ("Adjacency to " << neighbor << (up ? " up" : " down"));
+  m_adjacencyTrace (neighbor, up);
+  if (!m_adjacencyChanged.IsNull ()) {
+    m_adjacencyChanged (neighbor, up);
+  }
+}
+
+} // namespace ndn
+} // namespace ns3
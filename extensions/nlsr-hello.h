@@ -0,0 +1,183 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// nlsr-hello.h
+
+#ifndef NLSR_HELLO_H
+#define NLSR_HELLO_H
+
+#include "nlsr-lsu.h"
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/callback.h"
+#include "ns3/traced-callback.h"
+#include "ns3/ndn-interest.h"
+#include "ns3/ndn-data.h"
+
+#include <map>
+#include <vector>
+
+namespace ns3 {
+namespace ndn {
+
+static const std::string HELLO_PREFIX = "/nlsr/hello";  // /nlsr/hello/<to router>/<from router>/<n>
+static const uint16_t HELLO_PREFIX_SIZE = 2;
+static const double DEFAULT_HELLO_INTERVAL = 5.0;  // seconds
+static const uint32_t DEFAULT_DEAD_TIME = 15;      // seconds
+static const uint8_t HELLO_VERSION = 1;
+
+// ========== Class HelloProtocol ============
+
+/**
+ * @brief Liveness of the routers at the other end of our links
+ *
+ * Every HelloInterval a hello Interest goes to each candidate neighbor,
+ * which answers with a HelloData: its name, the neighbors it hears and the
+ * DeadTime after which it is to be taken for dead unless heard again.  A
+ * neighbor is up while its hellos keep coming within its dead time and it
+ * lists us, so the adjacency is two-way.  Up and down transitions are
+ * reported through the adjacency callback and the AdjacencyChanged trace
+ * source; a failed link is noticed within the dead time of the neighbor.
+ *
+ * The application owning the protocol sends its packets, through the send
+ * callbacks, and hands it the hello Interests and Data it receives.  Hello
+ * Interests reach the neighbor by a route for /nlsr/hello/<neighbor> on
+ * the face of the link, and the application by /nlsr/hello/<us>.
+ *
+ * With a digest callback set, each HelloData also carries the sync digest
+ * of its sender, and the digests heard from the neighbors that are up go
+ * to the neighbor digest callback: the hellos then tell when the sync
+ * state of a neighbor moved away from ours.
+ */
+class HelloProtocol : public Object {
+
+public:
+  typedef Callback<void, Ptr<Name>, Time> SendInterestCallback;  // name, lifetime
+  typedef Callback<void, Ptr<Data> > SendDataCallback;
+  typedef Callback<void, const std::string &, bool> AdjacencyCallback;  // neighbor, up
+  typedef Callback<uint64_t> DigestCallback;  // our sync digest
+  typedef Callback<void, const std::string &, uint64_t> NeighborDigestCallback;  // neighbor, its digest
+
+  HelloProtocol ();
+  virtual ~HelloProtocol ();
+
+  static TypeId
+  GetTypeId (void);
+
+  void
+  SetRouterName (const std::string & routerName);
+
+  void
+  SetSendCallbacks (SendInterestCallback sendInterest, SendDataCallback sendData);
+
+  void
+  SetAdjacencyCallback (AdjacencyCallback adjacencyChanged);
+
+  /// Piggyback getDigest () on our hellos, and report those of the neighbors
+  void
+  SetDigestCallbacks (DigestCallback getDigest, NeighborDigestCallback neighborDigest);
+
+  /// A router on one of our links, to say hello to
+  void
+  AddNeighbor (const std::string & neighbor);
+
+  void
+  Start ();
+
+  void
+  Stop ();
+
+  static bool
+  IsHelloName (Ptr<const Name> name);
+
+  void
+  OnHelloInterest (Ptr<const Interest> interest);
+
+  void
+  OnHelloData (Ptr<const Data> data);
+
+  bool
+  IsUp (const std::string & neighbor) const;
+
+  Time
+  GetHelloInterval () const;
+
+  void
+  SetHelloInterval (Time interval);
+
+  uint32_t
+  GetDeadTime () const;
+
+  void
+  SetDeadTime (uint32_t deadTime);
+
+protected:
+  virtual void
+  DoDispose ();
+
+private:
+  struct Neighbor
+  {
+    bool heard;         // a hello came within its dead time
+    bool up;            // heard, and it hears us
+    EventId deadEvent;
+
+    Neighbor ()
+    : heard (false), up (false)
+    {}
+  };
+  typedef std::map<std::string, Neighbor> NeighborMap;
+
+  void
+  SendHellos ();
+
+  void
+  OnDeadTime (std::string neighbor);
+
+  void
+  SetUp (const std::string & neighbor, Neighbor & state, bool up);
+
+private:
+  std::string m_routerName;
+  NeighborMap m_neighbors;
+  Time m_helloInterval;
+  uint32_t m_deadTime;  // seconds, as HelloData carries it
+  uint64_t m_helloSeq;  // keeps hello names apart, so that no cache answers them
+  EventId m_helloEvent;
+
+  // receive buffer of OnHelloData and the view over it, kept to reuse their storage
+  std::vector<uint8_t> m_rxBuffer;
+  HelloDataView m_rxHello;
+
+  SendInterestCallback m_sendInterest;
+  SendDataCallback m_sendData;
+  AdjacencyCallback m_adjacencyChanged;
+  DigestCallback m_getDigest;  // null: our hellos carry no digest
+  NeighborDigestCallback m_neighborDigest;
+
+  TracedCallback<const std::string &, bool> m_adjacencyTrace;
+
+}; // class HelloProtocol
+
+} // namespace ndn
+} // namespace ns3
+
+#endif // NLSR_HELLO_H
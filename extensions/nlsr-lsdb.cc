@@ -0,0 +1,252 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// nlsr-lsdb.cc
+
+#include "nlsr-lsdb.h"
+#include "sync-state.h"
+#include "ns3/assert.h"
+#include "ns3/log.h"
+#include "ns3/simulator.h"
+#include "ns3/trace-source-accessor.h"
+
+#include <algorithm>
+#include <cmath>
+
+NS_LOG_COMPONENT_DEFINE ("Lsdb");
+
+namespace ns3 {
+namespace ndn {
+
+// ========== Class Lsdb ============
+
+NS_OBJECT_ENSURE_REGISTERED (Lsdb);
+
+Lsdb::Lsdb ()
+  : m_tickInterval (Seconds (DEFAULT_LSDB_TICK))
+{
+}
+
+Lsdb::~Lsdb ()
+{
+}
+
+TypeId
+Lsdb::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("Lsdb")
+    .SetParent<Object> ()
+    .AddConstructor<Lsdb> ()
+    .AddAttribute ("TickInterval", "Granularity of LSU expiry; LSUs already stored keep their number of ticks",
+                   TimeValue (Seconds (DEFAULT_LSDB_TICK)),
+                   MakeTimeAccessor (&Lsdb::SetTickInterval, &Lsdb::GetTickInterval),
+                   MakeTimeChecker ())
+    .AddTraceSource ("Changed", "An LSU was added, replaced by a newer version, removed or expired",
+                     MakeTraceSourceAccessor (&Lsdb::m_changed))
+    ;
+  return tid;
+}
+
+void
+Lsdb::DoDispose ()
+{
+  Simulator::Cancel (m_tickEvent);
+  m_lsus.clear ();
+  Object::DoDispose ();
+}
+
+bool
+Lsdb::ParseLsuName (const std::string & name, std::string & key, uint64_t & seq)
+{
+  size_t keyLength;
+  if (SyncState::ParseName (name, keyLength, seq) == false ||
+      name.compare (0, NLSR_PREFIX.size (), NLSR_PREFIX) != 0) {
+    return false;
+  }
+  // /nlsr/<router>/<lsu>
+  if (std::count (name.begin (), name.begin () + keyLength, '/') != 3) {
+    return false;
+  }
+  key.assign (name, 0, keyLength);
+  return true;
+}
+
+std::string
+Lsdb::MakeLsuName (const std::string & key, uint64_t seq)
+{
+  std::string name;
+  return SyncState::IdSeqToName (key, seq, name);
+}
+
+std::string
+Lsdb::GetRouterName (const std::string & key)
+{
+  size_t begin = NLSR_PREFIX.size () + 1;
+  size_t end = key.find ('/', begin);
+  return key.substr (begin, end == std::string::npos ? std::string::npos : end - begin);
+}
+
+bool
+Lsdb::Install (const std::string & key, uint64_t seq, Ptr<const LsuContent> content)
+{
+  NS_ASSERT (!content->IsDelta ());
+  if (GetSeq (key) >= seq) {
+    NS_LOG_DEBUG ("Not newer: " << key << " " << seq);
+    return false;
+  }
+  Store (key, seq, content);
+  return true;
+}
+
+bool
+Lsdb::InstallDelta (const std::string & key, uint64_t seq, const LsuContent & delta)
+{
+  NS_ASSERT (delta.IsDelta ());
+  const Entry * entry = Find (key);
+  if (entry == 0 || entry->seq != delta.GetBaseVersion () || seq <= entry->seq) {
+    NS_LOG_DEBUG ("No base for delta: " << key << " " << seq << " base " << delta.GetBaseVersion ());
+    return false;
+  }
+
+  Ptr<LsuContent> content = Create<LsuContent> (*entry->content);
+  if (content->ApplyDelta (delta) == false) {
+    return false;
+  }
+  Store (key, seq, content);
+  return true;
+}
+
+void
+Lsdb::Store (const std::string & key, uint64_t seq, Ptr<const LsuContent> content)
+{
+  // a tick already under way expires the LSU up to one tick early, so it
+  // gets one more
+  uint64_t ticks = std::ceil (content->GetLifetime () / m_tickInterval.GetSeconds ());
+  if (m_tickEvent.IsRunning ()) {
+    ticks++;
+  }
+
+  Ptr<const LsuContent> old;
+  LsuMap::iterator i = m_lsus.find (key);
+  if (i == m_lsus.end ()) {
+    i = m_lsus.insert (std::make_pair (key, Entry ())).first;
+  } else {
+    old = i->second.content;
+    m_timers.Cancel (i->second.timer);
+  }
+  i->second.seq = seq;
+  i->second.content = content;
+  i->second.timer = m_timers.Schedule (ticks, key);
+  NS_LOG_DEBUG ("Installed: " << key << " " << seq << " lifetime " << content->GetLifetime ());
+
+  ScheduleTick ();
+  m_changed (key, old, content);
+}
+
+bool
+Lsdb::Remove (const std::string & key)
+{
+  LsuMap::iterator i = m_lsus.find (key);
+  if (i == m_lsus.end ()) {
+    return false;
+  }
+  Ptr<const LsuContent> old = i->second.content;
+  m_timers.Cancel (i->second.timer);
+  m_lsus.erase (i);
+  NS_LOG_DEBUG ("Removed: " << key);
+
+  m_changed (key, old, 0);
+  return true;
+}
+
+const Lsdb::Entry *
+Lsdb::Find (const std::string & key) const
+{
+  LsuMap::const_iterator i = m_lsus.find (key);
+  return i == m_lsus.end () ? 0 : &i->second;
+}
+
+uint64_t
+Lsdb::GetSeq (const std::string & key) const
+{
+  const Entry * entry = Find (key);
+  return entry == 0 ? 0 : entry->seq;
+}
+
+const Lsdb::LsuMap &
+Lsdb::GetLsus () const
+{
+  return m_lsus;
+}
+
+uint32_t
+Lsdb::GetSize () const
+{
+  return m_lsus.size ();
+}
+
+Time
+Lsdb::GetTickInterval () const
+{
+  return m_tickInterval;
+}
+
+void
+Lsdb::SetTickInterval (Time interval)
+{
+  NS_ASSERT (interval.IsStrictlyPositive ());
+  m_tickInterval = interval;
+  if (m_tickEvent.IsRunning ()) {
+    Simulator::Cancel (m_tickEvent);
+    ScheduleTick ();
+  }
+}
+
+void
+Lsdb::Tick ()
+{
+  m_expired.clear ();
+  m_timers.Advance (1, m_expired);
+  for (std::vector<std::string>::const_iterator key = m_expired.begin ();
+       key != m_expired.end ();
+       key++)
+  {
+    LsuMap::iterator i = m_lsus.find (*key);
+    NS_ASSERT (i != m_lsus.end ());
+    Ptr<const LsuContent> old = i->second.content;
+    m_lsus.erase (i);
+    NS_LOG_DEBUG ("Expired: " << *key);
+
+    m_changed (*key, old, 0);
+  }
+  ScheduleTick ();
+}
+
+void
+Lsdb::ScheduleTick ()
+{
+  if (m_tickEvent.IsRunning () || m_timers.Empty ()) {
+    return;
+  }
+  m_tickEvent = Simulator::Schedule (m_tickInterval, &Lsdb::Tick, this);
+}
+
+} // namespace ndn
+} // namespace ns3
@@ -0,0 +1,159 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// nlsr-lsdb.h
+
+#ifndef NLSR_LSDB_H
+#define NLSR_LSDB_H
+
+#include "nlsr-lsu.h"
+#include "timer-wheel.h"
+#include "ns3/object.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/traced-callback.h"
+
+#include <map>
+
+namespace ns3 {
+namespace ndn {
+
+static const std::string NLSR_PREFIX = "/nlsr";  // LSU names: /nlsr/<router>/<lsu>/<seq#>
+static const double DEFAULT_LSDB_TICK = 1.0;  // seconds
+
+// ========== Class Lsdb ============
+
+/**
+ * @brief The LSUs a router knows, by key /nlsr/<router>/<lsu>
+ *
+ * Only the newest version (seq#) of an LSU is kept.  Each is removed when
+ * its lifetime runs out, counted from when it was installed, unless a
+ * newer version replaces it first.  The lifetimes are kept in a
+ * TimerWheel that moves on one tick every TickInterval, so there is one
+ * scheduled event per node however many LSUs it holds, and only while it
+ * holds any.  An LSU expires within one tick after its lifetime.
+ *
+ * The Lsdb is aggregated to the node, where the routing computation finds
+ * it; every change is reported through the Changed trace source.
+ */
+class Lsdb : public Object {
+
+public:
+  struct Entry
+  {
+    uint64_t seq;
+    Ptr<const LsuContent> content;
+    TimerWheel<std::string>::Handle timer;
+  };
+  typedef std::map<std::string, Entry> LsuMap;
+
+  Lsdb ();
+  virtual ~Lsdb ();
+
+  static TypeId
+  GetTypeId (void);
+
+  /**
+   * @brief Split /nlsr/<router>/<lsu>/<seq#> into its key and seq#
+   *
+   * @returns false if name is not an LSU name
+   */
+  static bool
+  ParseLsuName (const std::string & name, std::string & key, uint64_t & seq);
+
+  static std::string
+  MakeLsuName (const std::string & key, uint64_t seq);
+
+  /// Router name of an LSU key
+  static std::string
+  GetRouterName (const std::string & key);
+
+  /**
+   * @brief Store version seq of the LSU key, a full LSU
+   *
+   * @returns false, keeping what is stored, if that is not older
+   */
+  bool
+  Install (const std::string & key, uint64_t seq, Ptr<const LsuContent> content);
+
+  /**
+   * @brief Store version seq of the LSU key from a delta against the
+   *        stored version
+   *
+   * @returns false, keeping what is stored, if the stored version is not
+   *          the base of delta or the delta does not fit it; the full LSU
+   *          should be fetched then
+   */
+  bool
+  InstallDelta (const std::string & key, uint64_t seq, const LsuContent & delta);
+
+  bool
+  Remove (const std::string & key);
+
+  /// @returns 0 if the LSU is not stored
+  const Entry *
+  Find (const std::string & key) const;
+
+  /// Stored version of the LSU key, 0 if none
+  uint64_t
+  GetSeq (const std::string & key) const;
+
+  const LsuMap &
+  GetLsus () const;
+
+  uint32_t
+  GetSize () const;
+
+  Time
+  GetTickInterval () const;
+
+  void
+  SetTickInterval (Time interval);
+
+protected:
+  virtual void
+  DoDispose ();
+
+private:
+  void
+  Store (const std::string & key, uint64_t seq, Ptr<const LsuContent> content);
+
+  void
+  Tick ();
+
+  void
+  ScheduleTick ();
+
+private:
+  LsuMap m_lsus;
+  TimerWheel<std::string> m_timers;  // key of the LSU each timer expires
+  Time m_tickInterval;
+  EventId m_tickEvent;
+  std::vector<std::string> m_expired;  // scratch of Tick
+
+  // key, the old LSU or 0 if it is new, the new LSU or 0 if it is gone
+  TracedCallback<const std::string &, Ptr<const LsuContent>, Ptr<const LsuContent> > m_changed;
+
+}; // class Lsdb
+
+} // namespace ndn
+} // namespace ns3
+
+#endif // NLSR_LSDB_H
@@ -21,44 +21,294 @@
 // nlsr-lsu.h
 
 #include "nlsr-lsu.h"
+#include "nlsr-tlv.h"
 #include "ns3/assert.h"
 #include "ns3/log.h"
 
+#include <algorithm>
+#include <map>
+#include <set>
+
 NS_LOG_COMPONENT_DEFINE ("NlsrLsu");
 
 namespace ns3 {
 namespace ndn {
 
+namespace {
+
+// bounds-checked cursor over a contiguous message, for the views
+class SpanReader {
+
+public:
+  SpanReader (const uint8_t * buffer, uint32_t size)
+  : m_pos (buffer), m_end (buffer + size)
+  {}
+
+  uint32_t
+  Left () const
+  {
+    return m_end - m_pos;
+  }
+
+  bool
+  ReadU8 (uint8_t & value)
+  {
+    if (Left () < 1) return false;
+    value = *m_pos++;
+    return true;
+  }
+
+  bool
+  ReadNtohU16 (uint16_t & value)
+  {
+    if (Left () < 2) return false;
+    value = (m_pos[0] << 8) | m_pos[1];
+    m_pos += 2;
+    return true;
+  }
+
+  bool
+  ReadNtohU32 (uint32_t & value)
+  {
+    if (Left () < 4) return false;
+    value = (uint32_t (m_pos[0]) << 24) | (m_pos[1] << 16) | (m_pos[2] << 8) | m_pos[3];
+    m_pos += 4;
+    return true;
+  }
+
+  // a U16 length followed by that many bytes
+  bool
+  ReadSpan (NameSpan & span)
+  {
+    uint16_t size;
+    if (!ReadNtohU16 (size) || Left () < size) return false;
+    span = NameSpan (reinterpret_cast<const char *> (m_pos), size);
+    m_pos += size;
+    return true;
+  }
+
+  // a VAR-NUMBER length followed by that many bytes
+  bool
+  ReadVarSpan (NameSpan & span)
+  {
+    uint64_t size;
+    if (!ReadVarNumber (size) || Left () < size) return false;
+    span = NameSpan (reinterpret_cast<const char *> (m_pos), size);
+    m_pos += size;
+    return true;
+  }
+
+  bool
+  ReadVarNumber (uint64_t & value)
+  {
+    return tlv::ReadVarNumber (m_pos, m_end, value);
+  }
+
+  // everything left, as one span
+  NameSpan
+  Rest ()
+  {
+    NameSpan span (reinterpret_cast<const char *> (m_pos), Left ());
+    m_pos = m_end;
+    return span;
+  }
+
+  // the U32 length word every format starts with; the reader is then
+  // limited to the message
+  bool
+  ReadMessageSize (uint8_t & encoding)
+  {
+    uint32_t lengthWord;
+    if (!ReadNtohU32 (lengthWord) || Left () < tlv::GetLength (lengthWord)) return false;
+    encoding = tlv::GetEncoding (lengthWord);
+    m_end = m_pos + tlv::GetLength (lengthWord);
+    return true;
+  }
+
+  // a U16 block length; block is set up to read just the block
+  bool
+  ReadBlock (SpanReader & block)
+  {
+    uint16_t size;
+    if (!ReadNtohU16 (size) || Left () < size) return false;
+    block = SpanReader (m_pos, size);
+    m_pos += size;
+    return true;
+  }
+
+  // a <type><length> block header; value is set up to read just the value
+  bool
+  ReadTlvBlock (uint64_t & type, SpanReader & value)
+  {
+    uint64_t size;
+    if (!ReadVarNumber (type) || !ReadVarNumber (size) || Left () < size) return false;
+    value = SpanReader (m_pos, size);
+    m_pos += size;
+    return true;
+  }
+
+private:
+  const uint8_t * m_pos;
+  const uint8_t * m_end;
+};
+
+// changes that turn the tuples of base into those of current, tuples
+// being identified by their name
+template<class Tuple>
+void
+DiffTuples (const std::vector<Tuple> & base, const std::vector<Tuple> & current,
+            std::string Tuple::* name, std::vector<LsuContent::TupleChange> & changes)
+{
+  std::map<std::string, uint16_t> baseMetric;
+  for (typename std::vector<Tuple>::const_iterator i = base.begin (); i != base.end (); i++) {
+    baseMetric[(*i).*name] = i->metric;
+  }
+  for (typename std::vector<Tuple>::const_iterator i = current.begin (); i != current.end (); i++) {
+    std::map<std::string, uint16_t>::iterator old = baseMetric.find ((*i).*name);
+    if (old == baseMetric.end ()) {
+      changes.push_back (LsuContent::TupleChange (LsuContent::ADD_TUPLE, (*i).*name, i->metric));
+      continue;
+    }
+    if (old->second != i->metric) {
+      changes.push_back (LsuContent::TupleChange (LsuContent::MODIFY_TUPLE, (*i).*name, i->metric));
+    }
+    baseMetric.erase (old);
+  }
+  // whatever is left is gone
+  for (std::map<std::string, uint16_t>::iterator i = baseMetric.begin (); i != baseMetric.end (); i++) {
+    changes.push_back (LsuContent::TupleChange (LsuContent::REMOVE_TUPLE, i->first, 0));
+  }
+}
+
+// whether every change refers to a tuple that exists (or, for an add,
+// does not) at the time it is applied
+template<class Tuple>
+bool
+CheckChanges (const std::vector<Tuple> & tuples, std::string Tuple::* name,
+              const std::vector<LsuContent::TupleChange> & changes)
+{
+  std::set<std::string> names;
+  for (typename std::vector<Tuple>::const_iterator i = tuples.begin (); i != tuples.end (); i++) {
+    names.insert ((*i).*name);
+  }
+  for (std::vector<LsuContent::TupleChange>::const_iterator i = changes.begin (); i != changes.end (); i++) {
+    bool present = names.count (i->name) > 0;
+    switch (i->type) {
+    case LsuContent::ADD_TUPLE:
+      if (present) return false;
+      names.insert (i->name);
+      break;
+    case LsuContent::REMOVE_TUPLE:
+      if (!present) return false;
+      names.erase (i->name);
+      break;
+    case LsuContent::MODIFY_TUPLE:
+      if (!present) return false;
+      break;
+    default:
+      return false;
+    }
+  }
+  return true;
+}
+
+// apply changes that passed CheckChanges; removed tuples are compacted
+// away in one pass at the end, keeping the order of the others
+template<class Tuple>
+void
+ApplyChanges (std::vector<Tuple> & tuples, std::string Tuple::* name,
+              const std::vector<LsuContent::TupleChange> & changes)
+{
+  std::map<std::string, size_t> index;
+  for (size_t k = 0; k < tuples.size (); k++) {
+    index[tuples[k].*name] = k;
+  }
+  std::vector<bool> removed (tuples.size (), false);
+  for (std::vector<LsuContent::TupleChange>::const_iterator i = changes.begin (); i != changes.end (); i++) {
+    switch (i->type) {
+    case LsuContent::ADD_TUPLE:
+      index[i->name] = tuples.size ();
+      tuples.push_back (Tuple (i->name, i->metric));
+      removed.push_back (false);
+      break;
+    case LsuContent::REMOVE_TUPLE:
+      removed[index[i->name]] = true;
+      index.erase (i->name);
+      break;
+    case LsuContent::MODIFY_TUPLE:
+      tuples[index[i->name]].metric = i->metric;
+      break;
+    }
+  }
+
+  size_t kept = 0;
+  for (size_t k = 0; k < tuples.size (); k++) {
+    if (!removed[k]) {
+      if (kept != k) {
+        tuples[kept] = tuples[k];
+      }
+      kept++;
+    }
+  }
+  tuples.resize (kept);
+}
+
+} // anonymous namespace
+
 // ========== Class LsuContent ============
 
 NS_OBJECT_ENSURE_REGISTERED (LsuContent);
 
-uint16_t
+struct LsuContent::Schema
+{
+  typedef schema::Record<NeighborTuple, schema::Seq<
+    schema::Field<NeighborTuple, schema::Number<uint16_t>, &NeighborTuple::metric>,
+    schema::Field<NeighborTuple, schema::String, &NeighborTuple::routerName> > > Neighbor;
+
+  typedef schema::Record<PrefixTuple, schema::Seq<
+    schema::Field<PrefixTuple, schema::Number<uint16_t>, &PrefixTuple::metric>,
+    schema::Field<PrefixTuple, schema::String, &PrefixTuple::prefixName> > > Prefix;
+
+  typedef schema::Record<TupleChange, schema::Seq<
+    schema::Field<TupleChange, schema::Octet, &TupleChange::type>,
+    schema::Field<TupleChange, schema::Number<uint16_t>, &TupleChange::metric>,
+    schema::Field<TupleChange, schema::String, &TupleChange::name> > > Change;
+
+  typedef schema::Section<LsuContent, tlv::LIFETIME, schema::Number<uint32_t>,
+                          &LsuContent::m_lifetime> Lifetime;
+  typedef schema::Section<LsuContent, tlv::ADJACENCY_LIST, schema::List<Neighbor>,
+                          &LsuContent::m_adjacency> Adjacency;
+  typedef schema::Section<LsuContent, tlv::REACHABILITY_LIST, schema::List<Prefix>,
+                          &LsuContent::m_reachability> Reachability;
+  typedef schema::Section<LsuContent, tlv::BASE_VERSION, schema::Number<uint64_t>,
+                          &LsuContent::m_baseVersion> BaseVersion;
+  typedef schema::Section<LsuContent, tlv::ADJACENCY_CHANGES, schema::List<Change>,
+                          &LsuContent::m_adjacencyChanges> AdjacencyChanges;
+  typedef schema::Section<LsuContent, tlv::REACHABILITY_CHANGES, schema::List<Change>,
+                          &LsuContent::m_reachabilityChanges> ReachabilityChanges;
+
+  typedef schema::Message<schema::Seq<Lifetime, Adjacency, Reachability> > Full;
+  typedef schema::Message<schema::Seq<Lifetime, BaseVersion, AdjacencyChanges, ReachabilityChanges> > Delta;
+  // what a TLV message may hold, full or delta
+  typedef schema::Message<schema::Seq<Lifetime, Adjacency, Reachability,
+                                      BaseVersion, AdjacencyChanges, ReachabilityChanges> > Any;
+};
+
+uint32_t
 LsuContent::GetAdjacencySize (void) const
 {
-  uint16_t size = 0;
-  for ( std::vector<LsuContent::NeighborTuple>::const_iterator i = m_adjacency.begin ();
-        i != m_adjacency.end ();
-        i++ ) {
-    size += sizeof (i->metric) + sizeof (size) + i->routerName.size(); 
-  }
-  return size;
+  return schema::List<Schema::Neighbor>::Length (m_adjacency, schema::LegacyFormat ());
 }
 
-uint16_t
+uint32_t
 LsuContent::GetReachabilitySize (void) const
 {
-  uint16_t size = 0;
-  for ( std::vector<LsuContent::PrefixTuple>::const_iterator i = m_reachability.begin ();
-        i != m_reachability.end ();
-        i++ ) {
-    size += sizeof (i->metric) + sizeof (size) + i->prefixName.size(); 
-  }
-  return size;
+  return schema::List<Schema::Prefix>::Length (m_reachability, schema::LegacyFormat ());
 }
 
 
 LsuContent::LsuContent ()
+  : m_encoding (tlv::LEGACY_ENCODING), m_baseVersion (0)
 {
 }
 
@@ -85,12 +335,9 @@ LsuContent::GetInstanceTypeId (void) const
 uint32_t
 LsuContent::GetSerializedSize (void) const
 {
-  uint32_t size = 0;
-  uint16_t smallSize = 0;
-  size = sizeof (size) + 
-         sizeof (m_lifetime) +
-         sizeof (smallSize) + LsuContent::GetAdjacencySize () +
-         sizeof (smallSize) + LsuContent::GetReachabilitySize(); 
+  // deltas have no fixed-width format
+  uint32_t size = IsDelta () ? Schema::Delta::Measure (*this, tlv::VARNUM_ENCODING, m_sizes)
+                             : Schema::Full::Measure (*this, m_encoding, m_sizes);
 
   NS_LOG_DEBUG ("GetSerializedSize LsuContent: " << size); 
 
@@ -117,113 +364,60 @@ LsuContent::Print (std::ostream &os) const
     os << "PrefixName:  " << prefixTuple->prefixName << "  Length:  " << prefixTuple->prefixName.size ()
        << "  Metric:  " << prefixTuple->metric << std::endl;
   }
+
+  if (IsDelta ()) {
+    os << "BaseVersion:  " << m_baseVersion << std::endl;
+    for ( std::vector<TupleChange>::const_iterator change = m_adjacencyChanges.begin ();
+          change != m_adjacencyChanges.end();
+          change++ ) {
+      os << "AdjacencyChange:  " << (uint16_t) change->type << "  RouterName:  " << change->name
+         << "  Metric:  " << change->metric << std::endl;
+    }
+    for ( std::vector<TupleChange>::const_iterator change = m_reachabilityChanges.begin ();
+          change != m_reachabilityChanges.end();
+          change++ ) {
+      os << "ReachabilityChange:  " << (uint16_t) change->type << "  PrefixName:  " << change->name
+         << "  Metric:  " << change->metric << std::endl;
+    }
+  }
 }
 
 void
 LsuContent::Serialize (Buffer::Iterator start) const
 {
   Buffer::Iterator i = start;
-  i.WriteHtonU32 (GetSerializedSize () - sizeof (uint32_t));
-
-  i.WriteHtonU32 (m_lifetime);
+  GetSerializedSize ();  // measures the sections, unless cached
 
-  i.WriteHtonU16 (GetAdjacencySize ());
-  for ( std::vector<LsuContent::NeighborTuple>::const_iterator neighborTuple = m_adjacency.begin ();
-        neighborTuple != m_adjacency.end();
-        neighborTuple++ ) {
-    i.WriteHtonU16 (neighborTuple->metric);
-    i.WriteHtonU16 (neighborTuple->routerName.size ());
-    i.Write ((const uint8_t *) neighborTuple->routerName.c_str (), neighborTuple->routerName.size());
-  }
-
-  i.WriteHtonU16 (GetReachabilitySize ());
-  for ( std::vector<LsuContent::PrefixTuple>::const_iterator prefixTuple = m_reachability.begin ();
-        prefixTuple != m_reachability.end();
-        prefixTuple++ ) {
-    i.WriteHtonU16 (prefixTuple->metric);
-    i.WriteHtonU16 (prefixTuple->prefixName.size ());
-    i.Write ((const uint8_t *) prefixTuple->prefixName.c_str (), prefixTuple->prefixName.size());
+  if (IsDelta ()) {
+    Schema::Delta::Write (i, *this, m_sizes);
+  } else {
+    Schema::Full::Write (i, *this, m_sizes);
   }
 }
 
 uint32_t
 LsuContent::Deserialize (Buffer::Iterator start)
 {
-  uint32_t messageSize = start.ReadNtohU32 ();
+  if (start.GetRemainingSize () < sizeof (uint32_t)) {
+    return 0;
+  }
+  uint32_t lengthWord = start.ReadNtohU32 ();
+  uint32_t messageSize = tlv::GetLength (lengthWord);
+  m_encoding = tlv::GetEncoding (lengthWord);
+  m_sizes.Invalidate ();
 
   //NS_LOG_DEBUG ("Deserialize LsuContent:" << messageSize); 
 
-  uint32_t leftSize = messageSize;
   Buffer::Iterator i = start;
-
-  NS_ASSERT (leftSize >= sizeof (m_lifetime));
-  m_lifetime = i.ReadNtohU32 ();
-  leftSize -= sizeof (m_lifetime);
-
-  uint16_t adjacencySize = i.ReadNtohU16 ();
-  //NS_LOG_DEBUG ("adjacencySize: " << adjacencySize << "  leftSize: " << leftSize); 
-
-  leftSize -= sizeof (adjacencySize);
-  NS_ASSERT (leftSize >= adjacencySize);
-  leftSize -= adjacencySize;
-
-
-  while (adjacencySize > 0) {
-    NeighborTuple neighborTuple;
-
-    NS_ASSERT (adjacencySize >= sizeof (neighborTuple.metric));
-    neighborTuple.metric = i.ReadNtohU16(); 
-    adjacencySize -= sizeof (neighborTuple.metric);
-
-    uint16_t stringSize = 0;
-
-    NS_ASSERT (adjacencySize >= sizeof (stringSize));
-    stringSize = i.ReadNtohU16(); 
-    adjacencySize -= sizeof (stringSize);
-
-    NS_ASSERT (adjacencySize >= stringSize);
-    adjacencySize -= stringSize;
-    neighborTuple.routerName.clear ();
-    for (; stringSize > 0; stringSize--) {
-      neighborTuple.routerName.push_back (i.ReadU8 ()); 
-    }
-
-    m_adjacency.push_back (neighborTuple);
-  }
- 
-  NS_ASSERT (leftSize >= sizeof (leftSize));
-  uint16_t reachabilitySize = i.ReadNtohU16 ();
-  //NS_LOG_DEBUG ("reachabilitySize: " << reachabilitySize << "  leftSize: " << leftSize); 
-
-  leftSize -= sizeof (reachabilitySize);
-  NS_ASSERT (leftSize >= reachabilitySize);
-  leftSize -= reachabilitySize;
-
-  while (reachabilitySize > 0) {
-    PrefixTuple prefixTuple;
-
-    NS_ASSERT (reachabilitySize >= sizeof (prefixTuple.metric));
-    prefixTuple.metric = i.ReadNtohU16(); 
-    reachabilitySize -= sizeof (prefixTuple.metric);
-
-    uint16_t stringSize = 0;
-    NS_ASSERT (reachabilitySize >= sizeof (stringSize));
-    stringSize = i.ReadNtohU16(); 
-    reachabilitySize -= sizeof (stringSize);
-
-    NS_ASSERT (reachabilitySize >= stringSize);
-    reachabilitySize -= stringSize;
-    prefixTuple.prefixName.clear ();
-    for (; stringSize > 0; stringSize--) {
-      prefixTuple.prefixName.push_back (i.ReadU8 ()); 
-    }
-
-    m_reachability.push_back (prefixTuple);
+  bool read = m_encoding == tlv::LEGACY_ENCODING ?
+              Schema::Full::ReadSequence (i, *this, messageSize, schema::LegacyFormat ()) :
+              Schema::Any::ReadBlocks (i, *this, messageSize);
+  if (!read) {
+    NS_LOG_DEBUG ("Malformed LsuContent of " << messageSize << " bytes");
+    return 0;
   }
- 
-  NS_ASSERT (leftSize == 0);
 
-  return messageSize + sizeof (messageSize);
+  return messageSize + sizeof (lengthWord);
 }
 
 uint32_t
@@ -236,6 +430,7 @@ void
 LsuContent::SetLifetime (uint32_t lifetime)
 {
   m_lifetime = lifetime;
+  m_sizes.Invalidate ();
 }
 
 const std::vector<LsuContent::NeighborTuple> &
@@ -249,6 +444,7 @@ LsuContent::AddAdjacency (const std::string &routerName, uint16_t metric)
 {
   NeighborTuple neighborTuple (routerName, metric);
   m_adjacency.push_back(neighborTuple);
+  m_sizes.Invalidate ();
 }
 
 const std::vector<LsuContent::PrefixTuple> & 
@@ -262,17 +458,125 @@ LsuContent::AddReachability (const std::string &prefixName, uint16_t metric)
 {
   PrefixTuple prefixTuple (prefixName, metric);
   m_reachability.push_back(prefixTuple);
+  m_sizes.Invalidate ();
+}
+
+uint8_t
+LsuContent::GetEncoding () const
+{
+  return m_encoding;
+}
+
+void
+LsuContent::SetEncoding (uint8_t encoding)
+{
+  m_encoding = encoding;
+  m_sizes.Invalidate ();
+}
+
+bool
+LsuContent::IsDelta () const
+{
+  return m_baseVersion != 0;
+}
+
+uint64_t
+LsuContent::GetBaseVersion () const
+{
+  return m_baseVersion;
+}
+
+const std::vector<LsuContent::TupleChange> &
+LsuContent::GetAdjacencyChanges () const
+{
+  return m_adjacencyChanges;
+}
+
+const std::vector<LsuContent::TupleChange> &
+LsuContent::GetReachabilityChanges () const
+{
+  return m_reachabilityChanges;
+}
+
+Ptr<LsuContent>
+LsuContent::MakeDelta (const LsuContent & base, uint64_t baseVersion, const LsuContent & current)
+{
+  NS_ASSERT (baseVersion != 0 && !base.IsDelta () && !current.IsDelta ());
+
+  Ptr<LsuContent> delta = Create<LsuContent> ();
+  delta->m_lifetime = current.m_lifetime;
+  delta->m_baseVersion = baseVersion;
+  DiffTuples (base.m_adjacency, current.m_adjacency, &NeighborTuple::routerName, delta->m_adjacencyChanges);
+  DiffTuples (base.m_reachability, current.m_reachability, &PrefixTuple::prefixName, delta->m_reachabilityChanges);
+  return delta;
+}
+
+Ptr<LsuContent>
+LsuContent::FromView (const LsuContentView & view)
+{
+  Ptr<LsuContent> lsu = Create<LsuContent> ();
+  lsu->m_lifetime = view.GetLifetime ();
+  lsu->m_encoding = view.GetEncoding ();
+  lsu->m_baseVersion = view.GetBaseVersion ();
+  for (std::vector<LsuContentView::NeighborSpan>::const_iterator i = view.GetAdjacency ().begin ();
+       i != view.GetAdjacency ().end ();
+       i++) {
+    lsu->m_adjacency.push_back (NeighborTuple (i->routerName.ToString (), i->metric));
+  }
+  for (std::vector<LsuContentView::PrefixSpan>::const_iterator i = view.GetReachability ().begin ();
+       i != view.GetReachability ().end ();
+       i++) {
+    lsu->m_reachability.push_back (PrefixTuple (i->prefixName.ToString (), i->metric));
+  }
+  for (std::vector<LsuContentView::ChangeSpan>::const_iterator i = view.GetAdjacencyChanges ().begin ();
+       i != view.GetAdjacencyChanges ().end ();
+       i++) {
+    lsu->m_adjacencyChanges.push_back (TupleChange (i->type, i->name.ToString (), i->metric));
+  }
+  for (std::vector<LsuContentView::ChangeSpan>::const_iterator i = view.GetReachabilityChanges ().begin ();
+       i != view.GetReachabilityChanges ().end ();
+       i++) {
+    lsu->m_reachabilityChanges.push_back (TupleChange (i->type, i->name.ToString (), i->metric));
+  }
+  return lsu;
+}
+
+bool
+LsuContent::ApplyDelta (const LsuContent & delta)
+{
+  NS_ASSERT (delta.IsDelta () && !IsDelta ());
+
+  if (!CheckChanges (m_adjacency, &NeighborTuple::routerName, delta.m_adjacencyChanges) ||
+      !CheckChanges (m_reachability, &PrefixTuple::prefixName, delta.m_reachabilityChanges)) {
+    NS_LOG_DEBUG ("Delta does not apply to this LSU");
+    return false;
+  }
+  ApplyChanges (m_adjacency, &NeighborTuple::routerName, delta.m_adjacencyChanges);
+  ApplyChanges (m_reachability, &PrefixTuple::prefixName, delta.m_reachabilityChanges);
+  m_lifetime = delta.m_lifetime;
+  m_sizes.Invalidate ();
+  return true;
 }
 
 // ========== Class NameListHeader ============
 
 NS_OBJECT_ENSURE_REGISTERED (NameListHeader);
 
+struct NameListHeader::Schema
+{
+  typedef schema::Message<schema::Seq<
+    schema::Body<NameListHeader, schema::List<schema::String>, &NameListHeader::m_nameList> > > Plain;
+  typedef schema::Message<schema::Seq<
+    schema::Body<NameListHeader, schema::FrontCodedList, &NameListHeader::m_nameList> > > FrontCoded;
+};
+
 NameListHeader::NameListHeader ()
+  : m_encoding (tlv::LEGACY_ENCODING)
 {
 }
 
 NameListHeader::NameListHeader (const std::vector<std::string> & nameList)
+  : m_encoding (tlv::LEGACY_ENCODING)
 {
    std::copy (nameList.begin(), nameList.end (), m_nameList.begin ());
 }
@@ -300,20 +604,25 @@ NameListHeader::GetInstanceTypeId (void) const
 uint32_t
 NameListHeader::GetSerializedSize (void) const
 {
-  uint32_t size = 0;
-  uint16_t smallSize = 0;
-
-  size += sizeof (size);
+  uint32_t size = m_encoding == tlv::FRONT_CODED_ENCODING ?
+                  Schema::FrontCoded::Measure (*this, m_encoding, m_sizes) :
+                  Schema::Plain::Measure (*this, m_encoding, m_sizes);
 
-  for ( std::vector<std::string>::const_iterator i = m_nameList.begin ();
-        i != m_nameList.end ();
-        i++ ) {
-    size += sizeof (smallSize) + i->size (); 
-  }
   NS_LOG_DEBUG ("GetSerializedSize NameListHeader: " << size); 
   return size;
 }
 
+uint32_t
+NameListHeader::GetNameSize (const std::string * previous, const std::string & name) const
+{
+  if (m_encoding == tlv::FRONT_CODED_ENCODING) {
+    return schema::FrontCodedList::NameSize (previous, name);
+  } else if (m_encoding == tlv::LEGACY_ENCODING) {
+    return schema::EncodedSize<schema::String> (name, schema::LegacyFormat ());
+  }
+  return schema::EncodedSize<schema::String> (name, schema::TlvFormat ());
+}
+
 void
 NameListHeader::Print (std::ostream &os) const
 {
@@ -329,51 +638,43 @@ void
 NameListHeader::Serialize (Buffer::Iterator start) const
 {
   Buffer::Iterator i = start;
-  i.WriteHtonU32 (GetSerializedSize () - sizeof (uint32_t));
+  GetSerializedSize ();  // measures the names, unless cached
 
-  for ( std::vector<std::string>::const_iterator name = m_nameList.begin ();
-        name != m_nameList.end();
-        name++ ) {
-    i.WriteHtonU16 (name->size ());
-    i.Write ((const uint8_t *) name->c_str (), name->size ());
+  if (m_encoding == tlv::FRONT_CODED_ENCODING) {
+    Schema::FrontCoded::Write (i, *this, m_sizes);
+  } else {
+    Schema::Plain::Write (i, *this, m_sizes);
   }
 }
 
 uint32_t
 NameListHeader::Deserialize (Buffer::Iterator start)
 {
-
-  uint32_t messageSize = start.ReadNtohU32 ();
+  if (start.GetRemainingSize () < sizeof (uint32_t)) {
+    return 0;
+  }
+  uint32_t lengthWord = start.ReadNtohU32 ();
+  uint32_t messageSize = tlv::GetLength (lengthWord);
+  m_encoding = tlv::GetEncoding (lengthWord);
+  m_sizes.Invalidate ();
 
   //NS_LOG_DEBUG ("Deserialize NameListHeader 1:" << messageSize); 
 
-  uint32_t leftSize = messageSize;
   Buffer::Iterator i = start;
-
-  while (leftSize > 0) {
-
-    std::string name;
-    uint16_t stringSize = 0;
-
-    NS_ASSERT (leftSize >= sizeof (stringSize));
-    stringSize = i.ReadNtohU16(); 
-    leftSize -= sizeof (stringSize);
-     
-    //NS_LOG_DEBUG ("leftSize: " << leftSize << "  stringSize: " << stringSize);
-
-    NS_ASSERT (leftSize >= stringSize);
-    leftSize -= stringSize;
-    name.clear ();
-    for (; stringSize > 0; stringSize--) {
-      name.push_back (i.ReadU8 ()); 
-    }
-
-    m_nameList.push_back (name);
+  bool read;
+  if (m_encoding == tlv::FRONT_CODED_ENCODING) {
+    read = Schema::FrontCoded::ReadSequence (i, *this, messageSize, schema::TlvFormat ());
+  } else if (m_encoding == tlv::LEGACY_ENCODING) {
+    read = Schema::Plain::ReadSequence (i, *this, messageSize, schema::LegacyFormat ());
+  } else {
+    read = Schema::Plain::ReadSequence (i, *this, messageSize, schema::TlvFormat ());
+  }
+  if (!read) {
+    NS_LOG_DEBUG ("Malformed NameListHeader of " << messageSize << " bytes");
+    return 0;
   }
- 
-  NS_ASSERT (leftSize == 0);
 
-  return messageSize + sizeof (messageSize);
+  return messageSize + sizeof (lengthWord);
 }
 
 const std::vector<std::string> &
@@ -382,23 +683,60 @@ NameListHeader::GetNameList () const
   return m_nameList;
 }
 
-std::vector<std::string> &
-NameListHeader::Get ()
+const std::vector<std::string> &
+NameListHeader::Get () const
 {
   return m_nameList;
 }
 
+void
+NameListHeader::Swap (std::vector<std::string> & nameList)
+{
+  m_nameList.swap (nameList);
+  m_sizes.Invalidate ();
+}
+
 void
 NameListHeader::AddName (const std::string &name)
 {
   m_nameList.push_back(name);
+  m_sizes.Invalidate ();
+}
+
+uint8_t
+NameListHeader::GetEncoding () const
+{
+  return m_encoding;
+}
+
+void
+NameListHeader::SetEncoding (uint8_t encoding)
+{
+  m_encoding = encoding;
+  m_sizes.Invalidate ();
 }
+
  
 // ========== Class HelloData ============
 
 NS_OBJECT_ENSURE_REGISTERED (HelloData);
 
+struct HelloData::Schema
+{
+  typedef schema::Section<HelloData, tlv::ROUTER_NAME, schema::String, &HelloData::m_routerName> RouterName;
+  typedef schema::Section<HelloData, tlv::NEIGHBOR_LIST, schema::List<schema::String>,
+                          &HelloData::m_neighborList> NeighborList;
+  typedef schema::Section<HelloData, tlv::DEAD_TIME, schema::Number<uint32_t>, &HelloData::m_deadTime> DeadTime;
+  typedef schema::Section<HelloData, tlv::HELLO_VERSION, schema::Octet, &HelloData::m_version> Version;
+  typedef schema::Section<HelloData, tlv::SYNC_DIGEST, schema::Number<uint64_t>, &HelloData::m_digest> Digest;
+
+  typedef schema::Message<schema::Seq<RouterName, NeighborList, DeadTime, Version> > Message;
+  // what a TLV message may hold, with or without a digest
+  typedef schema::Message<schema::Seq<RouterName, NeighborList, DeadTime, Version, Digest> > Any;
+};
+
 HelloData::HelloData ()
+  : m_digest (0), m_encoding (tlv::LEGACY_ENCODING)
 {
 }
 
@@ -428,27 +766,18 @@ HelloData::GetInstanceTypeId (void) const
 //  uint8_t m_version;
 
 
-uint16_t
+uint32_t
 HelloData::GetNeighborListSize (void) const
 {
-  uint16_t size = 0;
-  for ( std::vector<std::string>::const_iterator i = m_neighborList.begin ();
-        i != m_neighborList.end ();
-        i++ ) {
-    size += sizeof (uint16_t) + i->size (); 
-  }
-  return size;
+  return schema::List<schema::String>::Length (m_neighborList, schema::LegacyFormat ());
 }
 
 uint32_t
 HelloData::GetSerializedSize (void) const
 {
-  uint32_t size = 0;
-
-  size += sizeof (uint32_t);
-  size += sizeof (uint16_t) + m_routerName.size ();
-  size += sizeof (uint16_t) + GetNeighborListSize ();
-  size += sizeof (m_deadTime) + sizeof (m_version);
+  // the digest has no fixed-width format
+  uint32_t size = HasDigest () ? Schema::Any::Measure (*this, tlv::VARNUM_ENCODING, m_sizes)
+                               : Schema::Message::Measure (*this, m_encoding, m_sizes);
 
   NS_LOG_DEBUG ("GetSerializedSize HelloData: " << size); 
   return size;
@@ -468,79 +797,48 @@ HelloData::Print (std::ostream &os) const
 
   os << "DeadTime:  " << m_deadTime<< std::endl;
   os << "Version:  " << (uint16_t) m_version << std::endl;
+  if (HasDigest ()) {
+    os << "Digest:  " << m_digest << std::endl;
+  }
 }
 
 void
 HelloData::Serialize (Buffer::Iterator start) const
 {
   Buffer::Iterator i = start;
-  i.WriteHtonU32 (GetSerializedSize () - sizeof (uint32_t));
-
-  i.WriteHtonU16 (m_routerName.size ());
-  i.Write ((const uint8_t *) m_routerName.c_str (), m_routerName.size ());  
+  GetSerializedSize ();  // measures the sections, unless cached
 
-  i.WriteHtonU16 (GetNeighborListSize ());
-  for ( std::vector<std::string>::const_iterator name = m_neighborList.begin ();
-        name != m_neighborList.end();
-        name++ ) {
-    i.WriteHtonU16 (name->size ());
-    i.Write ((const uint8_t *) name->c_str (), name->size ());
+  if (HasDigest ()) {
+    Schema::Any::Write (i, *this, m_sizes);
+  } else {
+    Schema::Message::Write (i, *this, m_sizes);
   }
-  i.WriteHtonU32 (m_deadTime);
-  i.WriteU8 (m_version);
 }
 
 uint32_t
 HelloData::Deserialize (Buffer::Iterator start)
 {
-
-  uint32_t messageSize = start.ReadNtohU32 ();
+  if (start.GetRemainingSize () < sizeof (uint32_t)) {
+    return 0;
+  }
+  uint32_t lengthWord = start.ReadNtohU32 ();
+  uint32_t messageSize = tlv::GetLength (lengthWord);
+  m_encoding = tlv::GetEncoding (lengthWord);
+  m_digest = 0;
+  m_sizes.Invalidate ();
 
   //NS_LOG_DEBUG ("Deserialize HelloData:" << messageSize); 
 
-  uint32_t leftSize = messageSize;
   Buffer::Iterator i = start;
-
-  uint16_t nameSize = 0;
-  nameSize = i.ReadNtohU16 ();
-  //NS_LOG_DEBUG ("leftSize: " << leftSize << "  nameSize: " << nameSize);
-  leftSize -= (sizeof (uint16_t) + nameSize);
-
-  for (; nameSize > 0; nameSize--) {
-      m_routerName.push_back (i.ReadU8 ()); 
-  }
-   
-  uint16_t neighborListSize = i.ReadNtohU16 ();
-  leftSize -= ( sizeof (uint16_t) + neighborListSize );
-
-  while (neighborListSize > 0) {
-
-    std::string name;
-    uint16_t stringSize = 0;
-
-    NS_ASSERT (neighborListSize >= sizeof (stringSize));
-    stringSize = i.ReadNtohU16 (); 
-    neighborListSize -= sizeof (stringSize);
-    //NS_LOG_DEBUG ("neighborListSize: " << neighborListSize << "  stringSize: " << stringSize);
-     
-    NS_ASSERT (neighborListSize >= stringSize);
-    neighborListSize -= stringSize;
-    name.clear ();
-    for (; stringSize > 0; stringSize--) {
-      name.push_back (i.ReadU8 ()); 
-    }
-
-    m_neighborList.push_back (name);
+  bool read = m_encoding == tlv::LEGACY_ENCODING ?
+              Schema::Message::ReadSequence (i, *this, messageSize, schema::LegacyFormat ()) :
+              Schema::Any::ReadBlocks (i, *this, messageSize);
+  if (!read) {
+    NS_LOG_DEBUG ("Malformed HelloData of " << messageSize << " bytes");
+    return 0;
   }
- 
-  m_deadTime = i.ReadNtohU32 ();
-  m_version = i.ReadU8 ();
-
-  leftSize -= sizeof (m_deadTime) + sizeof (m_version);
 
-  NS_ASSERT (leftSize == 0);
-
-  return messageSize + sizeof (messageSize);
+  return messageSize + sizeof (lengthWord);
 }
 
 const std::string &
@@ -553,6 +851,7 @@ void
 HelloData::SetRouterName (const std::string & routerName)
 {
   m_routerName = routerName;
+  m_sizes.Invalidate ();
 }
 
 const std::vector<std::string> &
@@ -565,6 +864,7 @@ void
 HelloData::AddNeighborList (const std::string & neighborName)
 {
   m_neighborList.push_back (neighborName);
+  m_sizes.Invalidate ();
 }
 
 uint32_t
@@ -577,6 +877,7 @@ void
 HelloData::SetDeadTime (const uint32_t & deadTime)
 {
   m_deadTime = deadTime;
+  m_sizes.Invalidate ();
 }
 
 uint8_t
@@ -589,6 +890,430 @@ void
 HelloData::SetVersion (const uint8_t & version)
 {
   m_version = version;
+  m_sizes.Invalidate ();
+}
+
+bool
+HelloData::HasDigest () const
+{
+  return m_digest != 0;
+}
+
+uint64_t
+HelloData::GetDigest () const
+{
+  return m_digest;
+}
+
+void
+HelloData::SetDigest (uint64_t digest)
+{
+  m_digest = digest;
+  m_sizes.Invalidate ();
+}
+
+uint8_t
+HelloData::GetEncoding () const
+{
+  return m_encoding;
+}
+
+void
+HelloData::SetEncoding (uint8_t encoding)
+{
+  m_encoding = encoding;
+  m_sizes.Invalidate ();
+}
+
+// ========== Class SegmentHeader ============
+
+NS_OBJECT_ENSURE_REGISTERED (SegmentHeader);
+
+SegmentHeader::SegmentHeader (uint32_t finalSegment)
+  : m_finalSegment (finalSegment)
+{
+}
+
+SegmentHeader::~SegmentHeader ()
+{
+}
+
+TypeId
+SegmentHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("SegmentHeader")
+    .SetParent<Header> ()
+    .AddConstructor<SegmentHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+SegmentHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+void
+SegmentHeader::Print (std::ostream &os) const
+{
+  os << "=== SegmentHeader ===" << std::endl;
+  os << "FinalSegment:  " << m_finalSegment << std::endl;
+}
+
+uint32_t
+SegmentHeader::GetSerializedSize (void) const
+{
+  return sizeof (m_finalSegment);
+}
+
+void
+SegmentHeader::Serialize (Buffer::Iterator start) const
+{
+  start.WriteHtonU32 (m_finalSegment);
+}
+
+uint32_t
+SegmentHeader::Deserialize (Buffer::Iterator start)
+{
+  if (start.GetRemainingSize () < sizeof (m_finalSegment)) {
+    return 0;
+  }
+  m_finalSegment = start.ReadNtohU32 ();
+  return sizeof (m_finalSegment);
+}
+
+uint32_t
+SegmentHeader::Parse (const uint8_t * buffer, uint32_t size)
+{
+  SpanReader reader (buffer, size);
+  if (!reader.ReadNtohU32 (m_finalSegment)) {
+    return 0;
+  }
+  return sizeof (m_finalSegment);
+}
+
+uint32_t
+SegmentHeader::GetFinalSegment () const
+{
+  return m_finalSegment;
+}
+
+void
+SegmentHeader::SetFinalSegment (uint32_t finalSegment)
+{
+  m_finalSegment = finalSegment;
+}
+
+// ========== Class LsuContentView ============
+
+bool
+LsuContentView::Parse (const uint8_t * buffer, uint32_t size)
+{
+  m_lifetime = 0;
+  m_adjacency.clear ();
+  m_reachability.clear ();
+  m_baseVersion = 0;
+  m_adjacencyChanges.clear ();
+  m_reachabilityChanges.clear ();
+
+  SpanReader reader (buffer, size);
+  SpanReader block (0, 0);
+  if (!reader.ReadMessageSize (m_encoding)) {
+    return false;
+  }
+
+  if (m_encoding == tlv::LEGACY_ENCODING) {
+    if (!reader.ReadNtohU32 (m_lifetime) || !reader.ReadBlock (block)) {
+      return false;
+    }
+    while (block.Left () > 0) {
+      NeighborSpan neighbor;
+      if (!block.ReadNtohU16 (neighbor.metric) || !block.ReadSpan (neighbor.routerName)) {
+        return false;
+      }
+      m_adjacency.push_back (neighbor);
+    }
+
+    if (!reader.ReadBlock (block)) {
+      return false;
+    }
+    while (block.Left () > 0) {
+      PrefixSpan prefix;
+      if (!block.ReadNtohU16 (prefix.metric) || !block.ReadSpan (prefix.prefixName)) {
+        return false;
+      }
+      m_reachability.push_back (prefix);
+    }
+    return reader.Left () == 0;
+  }
+
+  uint64_t type;
+  uint64_t value;
+  while (reader.Left () > 0) {
+    if (!reader.ReadTlvBlock (type, block)) {
+      return false;
+    }
+    switch (type) {
+    case tlv::LIFETIME:
+      if (!block.ReadVarNumber (value)) {
+        return false;
+      }
+      m_lifetime = value;
+      break;
+    case tlv::ADJACENCY_LIST:
+      while (block.Left () > 0) {
+        NeighborSpan neighbor;
+        if (!block.ReadVarNumber (value) || !block.ReadVarSpan (neighbor.routerName)) {
+          return false;
+        }
+        neighbor.metric = value;
+        m_adjacency.push_back (neighbor);
+      }
+      break;
+    case tlv::REACHABILITY_LIST:
+      while (block.Left () > 0) {
+        PrefixSpan prefix;
+        if (!block.ReadVarNumber (value) || !block.ReadVarSpan (prefix.prefixName)) {
+          return false;
+        }
+        prefix.metric = value;
+        m_reachability.push_back (prefix);
+      }
+      break;
+    case tlv::BASE_VERSION:
+      if (!block.ReadVarNumber (m_baseVersion)) {
+        return false;
+      }
+      break;
+    case tlv::ADJACENCY_CHANGES:
+    case tlv::REACHABILITY_CHANGES:
+      while (block.Left () > 0) {
+        ChangeSpan change;
+        if (!block.ReadU8 (change.type) || !block.ReadVarNumber (value) || !block.ReadVarSpan (change.name)) {
+          return false;
+        }
+        change.metric = value;
+        (type == tlv::ADJACENCY_CHANGES ? m_adjacencyChanges : m_reachabilityChanges).push_back (change);
+      }
+      break;
+    default:  // unknown block, skipped
+      break;
+    }
+  }
+  return true;
+}
+
+uint32_t
+LsuContentView::GetLifetime () const
+{
+  return m_lifetime;
+}
+
+uint8_t
+LsuContentView::GetEncoding () const
+{
+  return m_encoding;
+}
+
+const std::vector<LsuContentView::NeighborSpan> &
+LsuContentView::GetAdjacency () const
+{
+  return m_adjacency;
+}
+
+const std::vector<LsuContentView::PrefixSpan> &
+LsuContentView::GetReachability () const
+{
+  return m_reachability;
+}
+
+uint64_t
+LsuContentView::GetBaseVersion () const
+{
+  return m_baseVersion;
+}
+
+const std::vector<LsuContentView::ChangeSpan> &
+LsuContentView::GetAdjacencyChanges () const
+{
+  return m_adjacencyChanges;
+}
+
+const std::vector<LsuContentView::ChangeSpan> &
+LsuContentView::GetReachabilityChanges () const
+{
+  return m_reachabilityChanges;
+}
+
+// ========== Class NameListView ============
+
+bool
+NameListView::Parse (const uint8_t * buffer, uint32_t size)
+{
+  m_nameList.clear ();
+
+  SpanReader reader (buffer, size);
+  uint8_t encoding;
+  if (!reader.ReadMessageSize (encoding)) {
+    return false;
+  }
+
+  if (encoding != tlv::FRONT_CODED_ENCODING) {
+    while (reader.Left () > 0) {
+      NameSpan name;
+      bool read = encoding == tlv::LEGACY_ENCODING ? reader.ReadSpan (name) : reader.ReadVarSpan (name);
+      if (!read) {
+        return false;
+      }
+      m_nameList.push_back (name);
+    }
+    return true;
+  }
+
+  // the names do not exist in the buffer; a first pass sizes the storage
+  // they are rebuilt in, so that it does not move under the spans
+  SpanReader sizing = reader;
+  uint64_t total = 0;
+  uint64_t previous = 0;
+  while (sizing.Left () > 0) {
+    uint64_t shared;
+    NameSpan suffix;
+    if (!sizing.ReadVarNumber (shared) || shared > previous || !sizing.ReadVarSpan (suffix)) {
+      return false;
+    }
+    previous = shared + suffix.size;
+    total += previous;
+  }
+  m_names.resize (std::max<uint64_t> (total, 1));
+
+  char * next = &m_names[0];
+  NameSpan name;
+  while (reader.Left () > 0) {
+    uint64_t shared;
+    NameSpan suffix;
+    reader.ReadVarNumber (shared);
+    reader.ReadVarSpan (suffix);
+    std::copy (name.data, name.data + shared, next);
+    std::copy (suffix.data, suffix.data + suffix.size, next + shared);
+    name = NameSpan (next, shared + suffix.size);
+    next += name.size;
+    m_nameList.push_back (name);
+  }
+  return true;
+}
+
+const NameSpanList &
+NameListView::GetNameList () const
+{
+  return m_nameList;
+}
+
+// ========== Class HelloDataView ============
+
+bool
+HelloDataView::Parse (const uint8_t * buffer, uint32_t size)
+{
+  m_routerName = NameSpan ();
+  m_neighborList.clear ();
+  m_deadTime = 0;
+  m_version = 0;
+  m_digest = 0;
+
+  SpanReader reader (buffer, size);
+  SpanReader block (0, 0);
+  uint8_t encoding;
+  if (!reader.ReadMessageSize (encoding)) {
+    return false;
+  }
+
+  if (encoding == tlv::LEGACY_ENCODING) {
+    if (!reader.ReadSpan (m_routerName) || !reader.ReadBlock (block)) {
+      return false;
+    }
+    while (block.Left () > 0) {
+      NameSpan name;
+      if (!block.ReadSpan (name)) {
+        return false;
+      }
+      m_neighborList.push_back (name);
+    }
+    if (!reader.ReadNtohU32 (m_deadTime) || !reader.ReadU8 (m_version)) {
+      return false;
+    }
+    return reader.Left () == 0;
+  }
+
+  uint64_t type;
+  uint64_t value;
+  while (reader.Left () > 0) {
+    if (!reader.ReadTlvBlock (type, block)) {
+      return false;
+    }
+    switch (type) {
+    case tlv::ROUTER_NAME:
+      m_routerName = block.Rest ();
+      break;
+    case tlv::NEIGHBOR_LIST:
+      while (block.Left () > 0) {
+        NameSpan name;
+        if (!block.ReadVarSpan (name)) {
+          return false;
+        }
+        m_neighborList.push_back (name);
+      }
+      break;
+    case tlv::DEAD_TIME:
+      if (!block.ReadVarNumber (value)) {
+        return false;
+      }
+      m_deadTime = value;
+      break;
+    case tlv::HELLO_VERSION:
+      if (!block.ReadU8 (m_version)) {
+        return false;
+      }
+      break;
+    case tlv::SYNC_DIGEST:
+      if (!block.ReadVarNumber (m_digest)) {
+        return false;
+      }
+      break;
+    default:  // unknown block, skipped
+      break;
+    }
+  }
+  return true;
+}
+
+const NameSpan &
+HelloDataView::GetRouterName () const
+{
+  return m_routerName;
+}
+
+const NameSpanList &
+HelloDataView::GetNeighborList () const
+{
+  return m_neighborList;
+}
+
+uint32_t
+HelloDataView::GetDeadTime () const
+{
+  return m_deadTime;
+}
+
+uint8_t
+HelloDataView::GetVersion () const
+{
+  return m_version;
+}
+
+uint64_t
+HelloDataView::GetDigest () const
+{
+  return m_digest;
 }
 
 } // namespace ndn
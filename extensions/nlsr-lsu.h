@@ -23,6 +23,8 @@
 #ifndef NLSR_LSU_H
 #define NLSR_LSU_H
 
+#include "name-span.h"
+#include "nlsr-schema.h"
 #include "ns3/header.h"
 
 namespace ns3 {
@@ -43,6 +45,8 @@ namespace ndn {
 //   reachability of prefix (optional): <prefix, metric>*
 //                                      prefix: name prefix
 
+class LsuContentView;
+
 // ========== Class NameListHeader ============
 
 class LsuContent : public Header, public SimpleRefCount<LsuContent> {
@@ -74,6 +78,28 @@ public:
     {}
   };
 
+  enum ChangeType
+  {
+    ADD_TUPLE = 1,
+    REMOVE_TUPLE = 2,
+    MODIFY_TUPLE = 3
+  };
+
+  // one operation of a delta LSU on an adjacency or prefix of its base
+  struct TupleChange
+  {
+    uint8_t type;
+    std::string name;
+    uint16_t metric;  // unused by REMOVE_TUPLE
+
+    TupleChange ()
+    {}
+
+    TupleChange (uint8_t t, std::string n, uint16_t m)
+    : type (t), name (n), metric (m)
+    {}
+  };
+
   LsuContent ();
   virtual ~LsuContent ();  
 
@@ -92,6 +118,7 @@ public:
   void
   Serialize (Buffer::Iterator start) const;
   
+  /// 0 if the message is truncated or inconsistent, with part of it read
   uint32_t
   Deserialize (Buffer::Iterator start);
 
@@ -113,17 +140,75 @@ public:
   void
   AddReachability (const std::string &prefixName, uint16_t metric);
 
+  /**
+   * @brief Encoding to serialize with, see nlsr-tlv.h
+   *
+   * LEGACY_ENCODING (the default) switches to VARNUM_ENCODING by itself
+   * when a section would not fit its U16 length.  Deserialize sets the
+   * encoding of the message it read.
+   */
+  uint8_t
+  GetEncoding () const;
+
+  void
+  SetEncoding (uint8_t encoding);
+
+  /**
+   * @brief Delta LSUs
+   *
+   * A delta LSU has a non-zero base version, the sequence number of the
+   * LSU it applies to.  Instead of the tuples it carries the changes that
+   * turn the base into this version, so a metric change on a router with
+   * thousands of prefixes costs one tuple.  Deltas are always sent in
+   * VARNUM_ENCODING.
+   */
+  bool
+  IsDelta () const;
+
+  uint64_t
+  GetBaseVersion () const;
+
+  const std::vector<TupleChange> &
+  GetAdjacencyChanges () const;
+
+  const std::vector<TupleChange> &
+  GetReachabilityChanges () const;
+
+  /// The delta from base, of version baseVersion, to current
+  static Ptr<LsuContent>
+  MakeDelta (const LsuContent & base, uint64_t baseVersion, const LsuContent & current);
+
+  /// A copy of the LSU view has parsed, names included
+  static Ptr<LsuContent>
+  FromView (const LsuContentView & view);
+
+  /**
+   * @brief Apply delta to this full LSU, which must be the delta's base
+   *
+   * @returns false, leaving this LSU untouched, if the changes do not fit
+   *          it; the receiver should then fetch the full LSU
+   */
+  bool
+  ApplyDelta (const LsuContent & delta);
+
 private:
-  uint16_t
+  struct Schema;  // wire layout, see nlsr-lsu.cc
+
+  uint32_t
   GetAdjacencySize (void) const;
 
-  uint16_t
+  uint32_t
   GetReachabilitySize (void) const;
 
 private:
   uint32_t m_lifetime; // count-down timer for soft-state protocol 
+  uint8_t m_encoding;
+  uint64_t m_baseVersion;  // 0 for a full LSU
+  std::vector<TupleChange> m_adjacencyChanges;
+  std::vector<TupleChange> m_reachabilityChanges;
   std::vector<NeighborTuple> m_adjacency;
   std::vector<PrefixTuple> m_reachability;
+  mutable schema::SizeCache m_sizes;
 
 }; // class LsuContent
 
@@ -158,14 +243,45 @@ public:
   const std::vector<std::string> &
   GetNameList () const;
 
-  std::vector<std::string> &
-  Get ();
+  const std::vector<std::string> &
+  Get () const;
+
+  /// Exchanges the names with nameList; the serialized size is measured again
+  void
+  Swap (std::vector<std::string> & nameList);
   
   void
   AddName (const std::string & name);
 
+  /**
+   * @brief LEGACY_ENCODING (default) or FRONT_CODED_ENCODING, see nlsr-tlv.h
+   *
+   * Front coding pays off when consecutive names share long prefixes, so
+   * the list should be sorted before it is serialized that way.
+   */
+  uint8_t
+  GetEncoding () const;
+
+  void
+  SetEncoding (uint8_t encoding);
+
+  /**
+   * @brief Bytes name takes in the serialized list, in the encoding set,
+   *        right behind previous (0 for the first name)
+   *
+   * GetSerializedSize () is the length word plus this for every name, so
+   * a list can be cut to size before it is built.
+   */
+  uint32_t
+  GetNameSize (const std::string * previous, const std::string & name) const;
+
+private:
+  struct Schema;  // wire layout, see nlsr-lsu.cc
+
 private:
   std::vector<std::string> m_nameList;
+  uint8_t m_encoding;
+  mutable schema::SizeCache m_sizes;
 
 }; // class NameListHeader
 
@@ -196,7 +312,7 @@ public:
   uint32_t
   Deserialize (Buffer::Iterator start);
   
-  uint16_t
+  uint32_t
   GetNeighborListSize (void) const;
 
   const std::string &
@@ -223,13 +339,197 @@ public:
   void
   SetVersion (const uint8_t & version);
 
+  /// A hello with the sync digest of the sender is sent in the TLV format
+  bool
+  HasDigest () const;
+
+  /// 0 if the hello carries no digest
+  uint64_t
+  GetDigest () const;
+
+  void
+  SetDigest (uint64_t digest);
+
+  /// Same as LsuContent::GetEncoding
+  uint8_t
+  GetEncoding () const;
+
+  void
+  SetEncoding (uint8_t encoding);
+
+private:
+  struct Schema;  // wire layout, see nlsr-lsu.cc
+
 private:
   std::string m_routerName;
   std::vector<std::string> m_neighborList;
   uint32_t m_deadTime;
   uint8_t m_version;
+  uint64_t m_digest;  // sync digest of the sender, 0 for none
+  uint8_t m_encoding;
+  mutable schema::SizeCache m_sizes;
 
-}; // class NameListHeader
+}; // class HelloData
+
+// ========== Class SegmentHeader ============
+
+/**
+ * @brief Precedes the payload of every segment of a segmented sync reply
+ *
+ * The segment number itself is the last name component; the header only
+ * carries the number of the final segment, which the receiver needs to
+ * know when the reply is complete.
+ */
+class SegmentHeader : public Header, public SimpleRefCount<SegmentHeader> {
+
+public:
+
+  SegmentHeader (uint32_t finalSegment = 0);
+  virtual ~SegmentHeader ();
+
+  static TypeId
+  GetTypeId (void);
+
+  virtual TypeId
+  GetInstanceTypeId (void) const;
+
+  void
+  Print (std::ostream &os) const;
+
+  uint32_t
+  GetSerializedSize (void) const;
+
+  void
+  Serialize (Buffer::Iterator start) const;
+
+  uint32_t
+  Deserialize (Buffer::Iterator start);
+
+  /// Read the header in front of a contiguous payload; 0 if it is truncated
+  uint32_t
+  Parse (const uint8_t * buffer, uint32_t size);
+
+  uint32_t
+  GetFinalSegment () const;
+
+  void
+  SetFinalSegment (uint32_t finalSegment);
+
+private:
+  uint32_t m_finalSegment;
+
+}; // class SegmentHeader
+
+// ========== Views ============
+//
+// Read-only parsers of the formats above.  They walk a contiguous copy of
+// the payload in place and hand out names as spans into it, so nothing is
+// allocated per name; the spans are valid until the buffer changes (or,
+// for a front-coded name list, until the view parses again).  Parse
+// returns false on a truncated or inconsistent message.
+
+class LsuContentView {
+
+public:
+  struct NeighborSpan
+  {
+    NameSpan routerName;
+    uint16_t metric;
+  };
+
+  struct PrefixSpan
+  {
+    NameSpan prefixName;
+    uint16_t metric;
+  };
+
+  struct ChangeSpan
+  {
+    uint8_t type;  // LsuContent::ChangeType
+    NameSpan name;
+    uint16_t metric;
+  };
+
+  bool
+  Parse (const uint8_t * buffer, uint32_t size);
+
+  uint32_t
+  GetLifetime () const;
+
+  uint8_t
+  GetEncoding () const;
+
+  const std::vector<NeighborSpan> &
+  GetAdjacency () const;
+
+  const std::vector<PrefixSpan> &
+  GetReachability () const;
+
+  uint64_t
+  GetBaseVersion () const;
+
+  const std::vector<ChangeSpan> &
+  GetAdjacencyChanges () const;
+
+  const std::vector<ChangeSpan> &
+  GetReachabilityChanges () const;
+
+private:
+  uint32_t m_lifetime;
+  uint8_t m_encoding;
+  std::vector<NeighborSpan> m_adjacency;
+  std::vector<PrefixSpan> m_reachability;
+  uint64_t m_baseVersion;
+  std::vector<ChangeSpan> m_adjacencyChanges;
+  std::vector<ChangeSpan> m_reachabilityChanges;
+
+}; // class LsuContentView
+
+class NameListView {
+
+public:
+  bool
+  Parse (const uint8_t * buffer, uint32_t size);
+
+  const NameSpanList &
+  GetNameList () const;
+
+private:
+  NameSpanList m_nameList;
+  std::vector<char> m_names;  // front-coded names are rebuilt here
+
+}; // class NameListView
+
+class HelloDataView {
+
+public:
+  bool
+  Parse (const uint8_t * buffer, uint32_t size);
+
+  const NameSpan &
+  GetRouterName () const;
+
+  const NameSpanList &
+  GetNeighborList () const;
+
+  uint32_t
+  GetDeadTime () const;
+
+  uint8_t
+  GetVersion () const;
+
+  /// 0 if the hello carries no digest
+  uint64_t
+  GetDigest () const;
+
+private:
+  NameSpan m_routerName;
+  NameSpanList m_neighborList;
+  uint32_t m_deadTime;
+  uint8_t m_version;
+  uint64_t m_digest;
+
+}; // class HelloDataView
 
 } // namespace ndn
 } // namespace ns3
@@ -0,0 +1,842 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// nlsr-schema.h
+
+#ifndef NLSR_SCHEMA_H
+#define NLSR_SCHEMA_H
+
+#include "nlsr-tlv.h"
+
+#include <boost/static_assert.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+namespace ndn {
+namespace schema {
+
+// A message is described once, as a Seq of sections, each naming the
+// member it encodes, its codec and its TLV block type:
+//
+//   typedef Seq<Section<HelloData, tlv::ROUTER_NAME, String, &HelloData::m_routerName>,
+//               Section<HelloData, tlv::DEAD_TIME, Number<uint32_t>, &HelloData::m_deadTime> > Schema;
+//
+// and Message<Schema> derives the size computation, encoder and decoder
+// for both formats of nlsr-tlv.h from it.  In the legacy format sections
+// follow each other, variable-length ones behind a U16 length; in the TLV
+// format each section is a <type><length><value> block.  List elements
+// are Records, a Seq of Fields encoded back to back.
+//
+// Every codec encodes a value in each format as Length () bytes, which
+// PREFIXED codecs put behind their length (a U16 in the legacy format, a
+// VAR-NUMBER in the TLV one) wherever nothing else delimits them.
+//
+// Decoding checks every length and count against the bytes actually left
+// and returns false instead of reading past them, so that a truncated or
+// inconsistent message from the network can be dropped.  A ReadValue gets
+// the exact length of a PREFIXED value, and for any other the room it may
+// take at most.
+
+static const uint32_t MAX_SECTIONS = 8;
+
+// ========== Formats ============
+
+struct LegacyFormat
+{
+  static uint32_t
+  PrefixSize (uint64_t length)
+  {
+    return sizeof (uint16_t);
+  }
+
+  static void
+  WritePrefix (Buffer::Iterator & i, uint64_t length)
+  {
+    NS_ASSERT (length <= tlv::MAX_LEGACY_LENGTH);
+    i.WriteHtonU16 (length);
+  }
+
+  static bool
+  ReadPrefix (Buffer::Iterator & i, uint64_t & left, uint64_t & length)
+  {
+    if (left < sizeof (uint16_t)) {
+      return false;
+    }
+    length = i.ReadNtohU16 ();
+    left -= sizeof (uint16_t);
+    return true;
+  }
+};
+
+struct TlvFormat
+{
+  static uint32_t
+  PrefixSize (uint64_t length)
+  {
+    return tlv::VarNumberSize (length);
+  }
+
+  static void
+  WritePrefix (Buffer::Iterator & i, uint64_t length)
+  {
+    tlv::WriteVarNumber (i, length);
+  }
+
+  static bool
+  ReadPrefix (Buffer::Iterator & i, uint64_t & left, uint64_t & length)
+  {
+    return tlv::ReadVarNumber (i, left, length);
+  }
+};
+
+// ========== Sequences ============
+
+struct Nil {};
+
+template<class A = Nil, class B = Nil, class C = Nil, class D = Nil,
+         class E = Nil, class F = Nil, class G = Nil, class H = Nil>
+struct Seq
+{
+  typedef A Head;
+  typedef Seq<B, C, D, E, F, G, H> Tail;
+};
+
+typedef Seq<> End;
+
+// ========== Codecs ============
+
+inline void WriteFixed (Buffer::Iterator & i, uint8_t value) { i.WriteU8 (value); }
+inline void WriteFixed (Buffer::Iterator & i, uint16_t value) { i.WriteHtonU16 (value); }
+inline void WriteFixed (Buffer::Iterator & i, uint32_t value) { i.WriteHtonU32 (value); }
+inline void WriteFixed (Buffer::Iterator & i, uint64_t value) { i.WriteHtonU64 (value); }
+
+inline void ReadFixed (Buffer::Iterator & i, uint8_t & value) { value = i.ReadU8 (); }
+inline void ReadFixed (Buffer::Iterator & i, uint16_t & value) { value = i.ReadNtohU16 (); }
+inline void ReadFixed (Buffer::Iterator & i, uint32_t & value) { value = i.ReadNtohU32 (); }
+inline void ReadFixed (Buffer::Iterator & i, uint64_t & value) { value = i.ReadNtohU64 (); }
+
+/// Fixed width in the legacy format, a VAR-NUMBER in the TLV one
+template<class T>
+struct Number
+{
+  typedef T Value;
+  static const bool PREFIXED = false;
+
+  static uint32_t
+  Length (const T & value, LegacyFormat)
+  {
+    return sizeof (T);
+  }
+
+  static uint32_t
+  Length (const T & value, TlvFormat)
+  {
+    return tlv::VarNumberSize (value);
+  }
+
+  static void
+  WriteValue (Buffer::Iterator & i, const T & value, LegacyFormat)
+  {
+    WriteFixed (i, value);
+  }
+
+  static void
+  WriteValue (Buffer::Iterator & i, const T & value, TlvFormat)
+  {
+    tlv::WriteVarNumber (i, value);
+  }
+
+  static bool
+  ReadValue (Buffer::Iterator & i, uint64_t length, T & value, LegacyFormat)
+  {
+    if (length < sizeof (T)) {
+      return false;
+    }
+    ReadFixed (i, value);
+    return true;
+  }
+
+  static bool
+  ReadValue (Buffer::Iterator & i, uint64_t length, T & value, TlvFormat)
+  {
+    uint64_t number;
+    if (!tlv::ReadVarNumber (i, length, number)) {
+      return false;
+    }
+    value = number;
+    return true;
+  }
+};
+
+/// One byte in both formats
+struct Octet
+{
+  typedef uint8_t Value;
+  static const bool PREFIXED = false;
+
+  template<class Format>
+  static uint32_t
+  Length (const uint8_t & value, Format)
+  {
+    return sizeof (uint8_t);
+  }
+
+  template<class Format>
+  static void
+  WriteValue (Buffer::Iterator & i, const uint8_t & value, Format)
+  {
+    i.WriteU8 (value);
+  }
+
+  template<class Format>
+  static bool
+  ReadValue (Buffer::Iterator & i, uint64_t length, uint8_t & value, Format)
+  {
+    if (length < sizeof (uint8_t)) {
+      return false;
+    }
+    value = i.ReadU8 ();
+    return true;
+  }
+};
+
+struct String
+{
+  typedef std::string Value;
+  static const bool PREFIXED = true;
+
+  template<class Format>
+  static uint32_t
+  Length (const std::string & value, Format)
+  {
+    return value.size ();
+  }
+
+  template<class Format>
+  static void
+  WriteValue (Buffer::Iterator & i, const std::string & value, Format)
+  {
+    i.Write ((const uint8_t *) value.data (), value.size ());
+  }
+
+  // one bulk copy into a string sized up front
+  template<class Format>
+  static bool
+  ReadValue (Buffer::Iterator & i, uint64_t length, std::string & value, Format)
+  {
+    value.resize (length);
+    if (length > 0) {
+      i.Read (reinterpret_cast<uint8_t *> (&value[0]), length);
+    }
+    return true;
+  }
+};
+
+// a value encoded wherever nothing else delimits it
+template<class Codec, class Format>
+uint32_t
+EncodedSize (const typename Codec::Value & value, Format format)
+{
+  uint32_t length = Codec::Length (value, format);
+  return Codec::PREFIXED ? Format::PrefixSize (length) + length : length;
+}
+
+template<class Codec, class Format>
+void
+Encode (Buffer::Iterator & i, const typename Codec::Value & value, Format format)
+{
+  if (Codec::PREFIXED) {
+    Format::WritePrefix (i, Codec::Length (value, format));
+  }
+  Codec::WriteValue (i, value, format);
+}
+
+// the same within the left bytes of what encloses it; takes the bytes
+// read off left
+template<class Codec, class Format>
+bool
+Decode (Buffer::Iterator & i, uint64_t & left, typename Codec::Value & value, Format format)
+{
+  uint64_t length = left;
+  if (Codec::PREFIXED && (!Format::ReadPrefix (i, left, length) || length > left)) {
+    return false;
+  }
+  Buffer::Iterator start = i;
+  if (!Codec::ReadValue (i, length, value, format)) {
+    return false;
+  }
+  left -= i.GetDistanceFrom (start);
+  return true;
+}
+
+/// Elements back to back; decoded ones are appended
+template<class Element>
+struct List
+{
+  typedef std::vector<typename Element::Value> Value;
+  static const bool PREFIXED = true;
+
+  template<class Format>
+  static uint32_t
+  Length (const Value & value, Format format)
+  {
+    uint32_t length = 0;
+    for (typename Value::const_iterator e = value.begin (); e != value.end (); e++) {
+      length += EncodedSize<Element> (*e, format);
+    }
+    return length;
+  }
+
+  template<class Format>
+  static void
+  WriteValue (Buffer::Iterator & i, const Value & value, Format format)
+  {
+    for (typename Value::const_iterator e = value.begin (); e != value.end (); e++) {
+      Encode<Element> (i, *e, format);
+    }
+  }
+
+  template<class Format>
+  static bool
+  ReadValue (Buffer::Iterator & i, uint64_t length, Value & value, Format format)
+  {
+    while (length > 0) {
+      value.push_back (typename Element::Value ());
+      if (!Decode<Element> (i, length, value.back (), format)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+/**
+ * @brief Sorted names sharing prefixes (tlv::FRONT_CODED_ENCODING)
+ *
+ * Each name is the VAR-NUMBER length it shares with the previous one, then
+ * the rest as a VAR-NUMBER-prefixed string, in both formats.
+ */
+struct FrontCodedList
+{
+  typedef std::vector<std::string> Value;
+  static const bool PREFIXED = true;
+
+  template<class Format>
+  static uint32_t
+  Length (const Value & value, Format)
+  {
+    uint32_t length = 0;
+    const std::string * previous = 0;
+    for (Value::const_iterator name = value.begin (); name != value.end (); name++) {
+      length += NameSize (previous, *name);
+      previous = &*name;
+    }
+    return length;
+  }
+
+  /// Bytes name takes right behind previous (0 for the first name)
+  static uint32_t
+  NameSize (const std::string * previous, const std::string & name)
+  {
+    uint32_t shared = previous != 0 ? SharedPrefixSize (*previous, name) : 0;
+    return tlv::VarNumberSize (shared) + tlv::VarNumberSize (name.size () - shared) + name.size () - shared;
+  }
+
+  template<class Format>
+  static void
+  WriteValue (Buffer::Iterator & i, const Value & value, Format)
+  {
+    const std::string empty;
+    const std::string * previous = &empty;
+    for (Value::const_iterator name = value.begin (); name != value.end (); name++) {
+      uint32_t shared = SharedPrefixSize (*previous, *name);
+      tlv::WriteVarNumber (i, shared);
+      tlv::WriteVarNumber (i, name->size () - shared);
+      i.Write ((const uint8_t *) name->data () + shared, name->size () - shared);
+      previous = &*name;
+    }
+  }
+
+  template<class Format>
+  static bool
+  ReadValue (Buffer::Iterator & i, uint64_t length, Value & value, Format)
+  {
+    std::string name;
+    while (length > 0) {
+      uint64_t shared;
+      uint64_t suffixSize;
+      if (!tlv::ReadVarNumber (i, length, shared) || shared > name.size () ||
+          !tlv::ReadVarNumber (i, length, suffixSize) || suffixSize > length) {
+        return false;
+      }
+      name.resize (shared + suffixSize);
+      if (suffixSize > 0) {
+        i.Read (reinterpret_cast<uint8_t *> (&name[shared]), suffixSize);
+      }
+      length -= suffixSize;
+      value.push_back (name);
+    }
+    return true;
+  }
+
+  static uint32_t
+  SharedPrefixSize (const std::string & a, const std::string & b)
+  {
+    uint32_t size = std::min (a.size (), b.size ());
+    uint32_t shared = 0;
+    while (shared < size && a[shared] == b[shared]) {
+      shared++;
+    }
+    return shared;
+  }
+};
+
+// ========== Records ============
+
+/// One member of a Record
+template<class Class, class Codec, typename Codec::Value Class::* Member>
+struct Field
+{
+  template<class Format>
+  static uint32_t
+  Size (const Class & object, Format format)
+  {
+    return EncodedSize<Codec> (object.*Member, format);
+  }
+
+  template<class Format>
+  static void
+  Write (Buffer::Iterator & i, const Class & object, Format format)
+  {
+    Encode<Codec> (i, object.*Member, format);
+  }
+
+  template<class Format>
+  static bool
+  Read (Buffer::Iterator & i, uint64_t & left, Class & object, Format format)
+  {
+    return Decode<Codec> (i, left, object.*Member, format);
+  }
+};
+
+template<class Fields>
+struct EachField
+{
+  typedef typename Fields::Head Head;
+  typedef EachField<typename Fields::Tail> Rest;
+
+  template<class Class, class Format>
+  static uint32_t
+  Size (const Class & object, Format format)
+  {
+    return Head::Size (object, format) + Rest::Size (object, format);
+  }
+
+  template<class Class, class Format>
+  static void
+  Write (Buffer::Iterator & i, const Class & object, Format format)
+  {
+    Head::Write (i, object, format);
+    Rest::Write (i, object, format);
+  }
+
+  template<class Class, class Format>
+  static bool
+  Read (Buffer::Iterator & i, uint64_t & left, Class & object, Format format)
+  {
+    return Head::Read (i, left, object, format) && Rest::Read (i, left, object, format);
+  }
+};
+
+template<>
+struct EachField<End>
+{
+  template<class Class, class Format>
+  static uint32_t
+  Size (const Class & object, Format format)
+  {
+    return 0;
+  }
+
+  template<class Class, class Format>
+  static void
+  Write (Buffer::Iterator & i, const Class & object, Format format)
+  {
+  }
+
+  template<class Class, class Format>
+  static bool
+  Read (Buffer::Iterator & i, uint64_t & left, Class & object, Format format)
+  {
+    return true;
+  }
+};
+
+/// A struct whose Fields are encoded back to back, e.g. as a List element
+template<class Class, class Fields>
+struct Record
+{
+  typedef Class Value;
+  static const bool PREFIXED = false;
+
+  template<class Format>
+  static uint32_t
+  Length (const Class & value, Format format)
+  {
+    return EachField<Fields>::Size (value, format);
+  }
+
+  template<class Format>
+  static void
+  WriteValue (Buffer::Iterator & i, const Class & value, Format format)
+  {
+    EachField<Fields>::Write (i, value, format);
+  }
+
+  template<class Format>
+  static bool
+  ReadValue (Buffer::Iterator & i, uint64_t length, Class & value, Format format)
+  {
+    return EachField<Fields>::Read (i, length, value, format);
+  }
+};
+
+// ========== Messages ============
+
+/**
+ * @brief Section lengths of one message, kept until the message changes
+ *
+ * ns-3 asks for the size of a header before serializing it; the lengths
+ * measured then are what Serialize writes, so neither walks the sections
+ * twice.  Owners Invalidate () it on every mutation.
+ */
+struct SizeCache
+{
+  bool valid;
+  uint8_t encoding;  // the encoding actually used on the wire
+  uint32_t total;
+  uint32_t lengths[MAX_SECTIONS];
+
+  SizeCache ()
+  : valid (false)
+  {}
+
+  void
+  Invalidate ()
+  {
+    valid = false;
+  }
+};
+
+/// One member of a message
+template<class Class, uint32_t Type, class Codec, typename Codec::Value Class::* Member>
+struct Section
+{
+  static const bool PREFIXED = Codec::PREFIXED;
+
+  template<class Format>
+  static uint32_t
+  Length (const Class & object, Format format)
+  {
+    return Codec::Length (object.*Member, format);
+  }
+
+  static uint32_t
+  Size (uint32_t length, LegacyFormat format)
+  {
+    return PREFIXED ? format.PrefixSize (length) + length : length;
+  }
+
+  static uint32_t
+  Size (uint32_t length, TlvFormat)
+  {
+    return tlv::BlockSize (Type, length);
+  }
+
+  static void
+  Write (Buffer::Iterator & i, const Class & object, uint32_t length, LegacyFormat format)
+  {
+    if (PREFIXED) {
+      format.WritePrefix (i, length);
+    }
+    Codec::WriteValue (i, object.*Member, format);
+  }
+
+  static void
+  Write (Buffer::Iterator & i, const Class & object, uint32_t length, TlvFormat format)
+  {
+    tlv::WriteBlockHeader (i, Type, length);
+    Codec::WriteValue (i, object.*Member, format);
+  }
+
+  template<class Format>
+  static bool
+  Read (Buffer::Iterator & i, Class & object, uint64_t & left, Format format)
+  {
+    return Decode<Codec> (i, left, object.*Member, format);
+  }
+
+  static bool
+  HasType (uint64_t type)
+  {
+    return type == Type;
+  }
+
+  static bool
+  ReadBlock (Buffer::Iterator & i, uint64_t length, Class & object)
+  {
+    return Codec::ReadValue (i, length, object.*Member, TlvFormat ());
+  }
+};
+
+/// The only member of a message, taking all of it in either format
+template<class Class, class Codec, typename Codec::Value Class::* Member>
+struct Body
+{
+  static const bool PREFIXED = false;
+
+  template<class Format>
+  static uint32_t
+  Length (const Class & object, Format format)
+  {
+    return Codec::Length (object.*Member, format);
+  }
+
+  template<class Format>
+  static uint32_t
+  Size (uint32_t length, Format)
+  {
+    return length;
+  }
+
+  template<class Format>
+  static void
+  Write (Buffer::Iterator & i, const Class & object, uint32_t length, Format format)
+  {
+    Codec::WriteValue (i, object.*Member, format);
+  }
+
+  template<class Format>
+  static bool
+  Read (Buffer::Iterator & i, Class & object, uint64_t & left, Format format)
+  {
+    if (!Codec::ReadValue (i, left, object.*Member, format)) {
+      return false;
+    }
+    left = 0;
+    return true;
+  }
+
+  static bool
+  HasType (uint64_t type)
+  {
+    return false;
+  }
+
+  static bool
+  ReadBlock (Buffer::Iterator & i, uint64_t length, Class & object)
+  {
+    return false;
+  }
+};
+
+template<class Sections, uint32_t Index = 0>
+struct EachSection
+{
+  BOOST_STATIC_ASSERT (Index < MAX_SECTIONS);
+
+  typedef typename Sections::Head Head;
+  typedef EachSection<typename Sections::Tail, Index + 1> Rest;
+
+  // fills lengths, returns the size of the sections
+  template<class Class, class Format>
+  static uint32_t
+  Measure (const Class & object, uint32_t * lengths, Format format)
+  {
+    lengths[Index] = Head::Length (object, format);
+    return Head::Size (lengths[Index], format) + Rest::Measure (object, lengths, format);
+  }
+
+  static bool
+  FitsLegacy (const uint32_t * lengths)
+  {
+    return (!Head::PREFIXED || lengths[Index] <= tlv::MAX_LEGACY_LENGTH) && Rest::FitsLegacy (lengths);
+  }
+
+  template<class Class, class Format>
+  static void
+  Write (Buffer::Iterator & i, const Class & object, const uint32_t * lengths, Format format)
+  {
+    Head::Write (i, object, lengths[Index], format);
+    Rest::Write (i, object, lengths, format);
+  }
+
+  template<class Class, class Format>
+  static bool
+  Read (Buffer::Iterator & i, Class & object, uint64_t & left, Format format)
+  {
+    return Head::Read (i, object, left, format) && Rest::Read (i, object, left, format);
+  }
+
+  // false only if the block is of a known type and does not decode
+  template<class Class>
+  static bool
+  ReadBlock (Buffer::Iterator & i, uint64_t type, uint64_t length, Class & object)
+  {
+    if (Head::HasType (type)) {
+      return Head::ReadBlock (i, length, object);
+    }
+    return Rest::ReadBlock (i, type, length, object);
+  }
+};
+
+template<uint32_t Index>
+struct EachSection<End, Index>
+{
+  template<class Class, class Format>
+  static uint32_t
+  Measure (const Class & object, uint32_t * lengths, Format format)
+  {
+    return 0;
+  }
+
+  static bool
+  FitsLegacy (const uint32_t * lengths)
+  {
+    return true;
+  }
+
+  template<class Class, class Format>
+  static void
+  Write (Buffer::Iterator & i, const Class & object, const uint32_t * lengths, Format format)
+  {
+  }
+
+  template<class Class, class Format>
+  static bool
+  Read (Buffer::Iterator & i, Class & object, uint64_t & left, Format format)
+  {
+    return true;
+  }
+
+  template<class Class>
+  static bool
+  ReadBlock (Buffer::Iterator & i, uint64_t type, uint64_t length, Class & object)
+  {
+    return true;
+  }
+};
+
+/**
+ * @brief Codec of a whole message: the U32 length word, then the sections
+ *
+ * Measure picks the wire encoding (LEGACY_ENCODING falls back to
+ * VARNUM_ENCODING when a variable-length section does not fit its U16
+ * length) and caches the section lengths that Write then uses.  Any other
+ * encoding is written in the TLV format, which is all a body codec like
+ * FrontCodedList needs.
+ */
+template<class Sections>
+struct Message
+{
+  typedef EachSection<Sections> Each;
+
+  template<class Class>
+  static uint32_t
+  Measure (const Class & object, uint8_t encoding, SizeCache & cache)
+  {
+    if (cache.valid) {
+      return cache.total;
+    }
+    cache.encoding = encoding;
+    if (encoding == tlv::LEGACY_ENCODING) {
+      cache.total = sizeof (uint32_t) + Each::Measure (object, cache.lengths, LegacyFormat ());
+      if (!Each::FitsLegacy (cache.lengths)) {
+        cache.encoding = tlv::VARNUM_ENCODING;
+      }
+    }
+    if (cache.encoding != tlv::LEGACY_ENCODING) {
+      cache.total = sizeof (uint32_t) + Each::Measure (object, cache.lengths, TlvFormat ());
+    }
+    cache.valid = true;
+    return cache.total;
+  }
+
+  template<class Class>
+  static void
+  Write (Buffer::Iterator & i, const Class & object, const SizeCache & cache)
+  {
+    NS_ASSERT (cache.valid);
+    i.WriteHtonU32 (tlv::MakeLengthWord (cache.encoding, cache.total - sizeof (uint32_t)));
+    if (cache.encoding == tlv::LEGACY_ENCODING) {
+      Each::Write (i, object, cache.lengths, LegacyFormat ());
+    } else {
+      Each::Write (i, object, cache.lengths, TlvFormat ());
+    }
+  }
+
+  /**
+   * @brief The sections in order, as Write puts them
+   *
+   * @returns false if they run past the size bytes of the body, or do not
+   *          take all of them
+   */
+  template<class Class, class Format>
+  static bool
+  ReadSequence (Buffer::Iterator & i, Class & object, uint32_t size, Format format)
+  {
+    uint64_t left = size;
+    return size <= i.GetRemainingSize () && Each::Read (i, object, left, format) && left == 0;
+  }
+
+  /// TLV blocks in any order; blocks of unknown type are skipped
+  template<class Class>
+  static bool
+  ReadBlocks (Buffer::Iterator & i, Class & object, uint32_t size)
+  {
+    if (size > i.GetRemainingSize ()) {
+      return false;
+    }
+    uint64_t left = size;
+    while (left > 0) {
+      uint64_t type;
+      uint64_t length;
+      if (!tlv::ReadVarNumber (i, left, type) || !tlv::ReadVarNumber (i, left, length) || length > left) {
+        return false;
+      }
+      Buffer::Iterator value = i;
+      if (!Each::ReadBlock (i, type, length, object)) {
+        return false;
+      }
+      i = value;
+      i.Next (length);
+      left -= length;
+    }
+    return true;
+  }
+};
+
+} // namespace schema
+} // namespace ndn
+} // namespace ns3
+
+#endif /* NLSR_SCHEMA_H */
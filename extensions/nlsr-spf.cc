@@ -0,0 +1,548 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// nlsr-spf.cc
+
+#include "nlsr-spf.h"
+#include "ns3/assert.h"
+#include "ns3/log.h"
+#include "ns3/trace-source-accessor.h"
+#include "ns3/uinteger.h"
+
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("Spf");
+
+namespace ns3 {
+namespace ndn {
+
+// ========== Class Spf ============
+
+NS_OBJECT_ENSURE_REGISTERED (Spf);
+
+const RouterHandle Spf::NO_ROUTER;
+
+Spf::Spf ()
+  : m_root (NO_ROUTER)
+  , m_tree (this, NO_ROUTER)
+  , m_fibReconciler (CreateObject<FibReconciler> ())
+  , m_maxNextHops (DEFAULT_MAX_NEXT_HOPS)
+{
+}
+
+Spf::~Spf ()
+{
+}
+
+TypeId
+Spf::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("Spf")
+    .SetParent<Object> ()
+    .AddConstructor<Spf> ()
+    .AddAttribute ("MaxNextHops", "Number of loop-free next hops a prefix is routed through at most",
+                   UintegerValue (DEFAULT_MAX_NEXT_HOPS),
+                   MakeUintegerAccessor (&Spf::SetMaxNextHops, &Spf::GetMaxNextHops),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddTraceSource ("Repaired", "Number of routers whose distance or parent an LSU change moved",
+                     MakeTraceSourceAccessor (&Spf::m_repaired))
+    ;
+  return tid;
+}
+
+void
+Spf::DoDispose ()
+{
+  if (m_lsdb != 0) {
+    m_lsdb->TraceDisconnectWithoutContext ("Changed", MakeCallback (&Spf::OnLsuChanged, this));
+    m_lsdb = 0;
+  }
+  m_neighborFaces.clear ();
+  m_neighborTrees.clear ();
+  m_fibReconciler = 0;
+  Object::DoDispose ();
+}
+
+void
+Spf::SetRouterName (const std::string & routerName)
+{
+  NS_ASSERT (m_root == NO_ROUTER);
+  m_root = InternRouter (routerName);
+  m_tree = Tree (this, m_root);
+  m_tree.Build ();
+}
+
+void
+Spf::SetFib (Ptr<Fib> fib)
+{
+  m_fibReconciler->SetFib (fib);
+}
+
+Ptr<FibReconciler>
+Spf::GetFibReconciler () const
+{
+  return m_fibReconciler;
+}
+
+void
+Spf::SetLsdb (Ptr<Lsdb> lsdb)
+{
+  NS_ASSERT (m_root != NO_ROUTER && m_lsdb == 0);
+  m_lsdb = lsdb;
+  for (Lsdb::LsuMap::const_iterator i = lsdb->GetLsus ().begin (); i != lsdb->GetLsus ().end (); i++) {
+    OnLsuChanged (i->first, 0, i->second.content);
+  }
+  m_lsdb->TraceConnectWithoutContext ("Changed", MakeCallback (&Spf::OnLsuChanged, this));
+}
+
+void
+Spf::SetNeighborFace (const std::string & neighbor, Ptr<Face> face)
+{
+  RouterHandle handle = InternRouter (neighbor);
+  m_neighborFaces[neighbor] = face;
+  if (m_neighborTrees.count (handle) == 0) {
+    m_neighborTrees.insert (std::make_pair (handle, Tree (this, handle))).first->second.Build ();
+  }
+  UpdateAllRoutes ();
+}
+
+void
+Spf::RemoveNeighborFace (const std::string & neighbor)
+{
+  if (m_neighborFaces.erase (neighbor) == 0) {
+    return;
+  }
+  m_neighborTrees.erase (m_routerHandles[neighbor]);
+  UpdateAllRoutes ();
+}
+
+uint32_t
+Spf::GetMaxNextHops () const
+{
+  return m_maxNextHops;
+}
+
+void
+Spf::SetMaxNextHops (uint32_t maxNextHops)
+{
+  NS_ASSERT (maxNextHops > 0);
+  m_maxNextHops = maxNextHops;
+  UpdateAllRoutes ();
+}
+
+uint32_t
+Spf::GetDistance (const std::string & router) const
+{
+  std::map<std::string, RouterHandle>::const_iterator i = m_routerHandles.find (router);
+  return i == m_routerHandles.end () ? SPF_INFINITY : m_tree.GetDistance (i->second);
+}
+
+std::string
+Spf::GetNextHop (const std::string & router) const
+{
+  std::map<std::string, RouterHandle>::const_iterator i = m_routerHandles.find (router);
+  if (i == m_routerHandles.end () || m_tree.GetFirstHop (i->second) == NO_ROUTER) {
+    return "";
+  }
+  return m_routers[m_tree.GetFirstHop (i->second)].name;
+}
+
+Ptr<Face>
+Spf::GetRoute (const std::string & prefix, uint32_t & cost) const
+{
+  const NextHopSet * nextHops = m_fibReconciler->GetNextHops (prefix);
+  if (nextHops == 0) {
+    return 0;
+  }
+  NextHopSet::const_iterator best = nextHops->begin ();
+  for (NextHopSet::const_iterator i = nextHops->begin (); i != nextHops->end (); i++) {
+    if (i->second < best->second) {
+      best = i;
+    }
+  }
+  cost = best->second;
+  return best->first;
+}
+
+void
+Spf::OnLsuChanged (const std::string & key, Ptr<const LsuContent> oldLsu, Ptr<const LsuContent> newLsu)
+{
+  RouterHandle u = InternRouter (Lsdb::GetRouterName (key));
+  MetricMap adjacency;
+  std::vector<std::string> prefixes;
+  if (newLsu != 0) {
+    const std::vector<LsuContent::NeighborTuple> & neighbors = newLsu->GetAdjacency ();
+    for (std::vector<LsuContent::NeighborTuple>::const_iterator i = neighbors.begin ();
+         i != neighbors.end ();
+         i++)
+    {
+      RouterHandle v = InternRouter (i->routerName);
+      if (v != u) {
+        adjacency[v] = i->metric;
+      }
+    }
+    const std::vector<LsuContent::PrefixTuple> & reachability = newLsu->GetReachability ();
+    for (std::vector<LsuContent::PrefixTuple>::const_iterator i = reachability.begin ();
+         i != reachability.end ();
+         i++)
+    {
+      prefixes.push_back (i->prefixName);
+    }
+  }
+  Router & router = m_routers[u];
+
+  // the links both ways between u and the routers it lists, before and after
+  std::vector<RouterHandle> neighbors;
+  for (MetricMap::const_iterator i = router.adjacency.begin (); i != router.adjacency.end (); i++) {
+    neighbors.push_back (i->first);
+  }
+  for (MetricMap::const_iterator i = adjacency.begin (); i != adjacency.end (); i++) {
+    if (router.adjacency.count (i->first) == 0) {
+      neighbors.push_back (i->first);
+    }
+  }
+  std::vector<std::pair<uint32_t, uint32_t> > oldMetrics;
+  for (std::vector<RouterHandle>::const_iterator v = neighbors.begin (); v != neighbors.end (); v++) {
+    oldMetrics.push_back (std::make_pair (GetLinkMetric (u, *v), GetLinkMetric (*v, u)));
+  }
+  router.adjacency.swap (adjacency);
+
+  std::vector<LinkChange> changes;
+  bool rootLinks = false;  // the links of the next hops themselves
+  for (uint32_t k = 0; k < neighbors.size (); k++) {
+    RouterHandle v = neighbors[k];
+    uint32_t out = GetLinkMetric (u, v);
+    uint32_t in = GetLinkMetric (v, u);
+    if (out != oldMetrics[k].first) {
+      changes.push_back (LinkChange (u, v, oldMetrics[k].first, out));
+    }
+    if (in != oldMetrics[k].second) {
+      changes.push_back (LinkChange (v, u, oldMetrics[k].second, in));
+    }
+    if ((out != oldMetrics[k].first || in != oldMetrics[k].second) && (u == m_root || v == m_root)) {
+      rootLinks = true;
+    }
+  }
+
+  for (std::vector<std::string>::const_iterator p = router.prefixes.begin (); p != router.prefixes.end (); p++) {
+    std::map<std::string, MetricMap>::iterator origins = m_prefixOrigins.find (*p);
+    if (origins == m_prefixOrigins.end ()) {
+      continue;  // listed twice
+    }
+    origins->second.erase (u);
+    if (origins->second.empty ()) {
+      m_prefixOrigins.erase (origins);
+    }
+    m_dirtyPrefixes.insert (*p);
+  }
+  router.prefixes.swap (prefixes);
+  if (newLsu != 0) {
+    const std::vector<LsuContent::PrefixTuple> & reachability = newLsu->GetReachability ();
+    for (std::vector<LsuContent::PrefixTuple>::const_iterator i = reachability.begin ();
+         i != reachability.end ();
+         i++)
+    {
+      m_prefixOrigins[i->prefixName][u] = i->metric;
+      m_dirtyPrefixes.insert (i->prefixName);
+    }
+  }
+
+  NS_LOG_DEBUG ("LSU of " << router.name << ": " << changes.size () << " link changes");
+  m_tree.Repair (changes);
+  MarkTouched (m_tree);
+  for (std::map<RouterHandle, Tree>::iterator i = m_neighborTrees.begin (); i != m_neighborTrees.end (); i++) {
+    i->second.Repair (changes);
+    MarkTouched (i->second);
+  }
+  m_repaired (m_tree.GetTouched ().size ());
+
+  if (rootLinks) {
+    UpdateAllRoutes ();
+  } else {
+    UpdateRoutes ();
+  }
+}
+
+RouterHandle
+Spf::InternRouter (const std::string & name)
+{
+  std::map<std::string, RouterHandle>::iterator i = m_routerHandles.find (name);
+  if (i != m_routerHandles.end ()) {
+    return i->second;
+  }
+  RouterHandle handle = m_routers.size ();
+  m_routers.push_back (Router (name));
+  m_routerHandles.insert (std::make_pair (name, handle));
+  return handle;
+}
+
+uint32_t
+Spf::GetLinkMetric (RouterHandle from, RouterHandle to) const
+{
+  MetricMap::const_iterator i = m_routers[from].adjacency.find (to);
+  if (i == m_routers[from].adjacency.end () || m_routers[to].adjacency.count (from) == 0) {
+    return SPF_INFINITY;
+  }
+  return i->second;
+}
+
+uint32_t
+Spf::GetPrefixDistance (const Tree & tree, const MetricMap & origins) const
+{
+  uint32_t distance = SPF_INFINITY;
+  for (MetricMap::const_iterator i = origins.begin (); i != origins.end (); i++) {
+    uint32_t origin = tree.GetDistance (i->first);
+    if (origin != SPF_INFINITY) {
+      distance = std::min (distance, origin + i->second);
+    }
+  }
+  return distance;
+}
+
+void
+Spf::MarkTouched (const Tree & tree)
+{
+  const std::vector<RouterHandle> & touched = tree.GetTouched ();
+  for (std::vector<RouterHandle>::const_iterator x = touched.begin (); x != touched.end (); x++) {
+    m_dirtyPrefixes.insert (m_routers[*x].prefixes.begin (), m_routers[*x].prefixes.end ());
+  }
+}
+
+void
+Spf::UpdateRoutes ()
+{
+  for (std::set<std::string>::const_iterator p = m_dirtyPrefixes.begin (); p != m_dirtyPrefixes.end (); p++) {
+    UpdateRoute (*p);
+  }
+  m_dirtyPrefixes.clear ();
+  m_fibReconciler->Commit ();
+}
+
+void
+Spf::UpdateAllRoutes ()
+{
+  for (std::map<std::string, MetricMap>::const_iterator i = m_prefixOrigins.begin ();
+       i != m_prefixOrigins.end ();
+       i++)
+  {
+    m_dirtyPrefixes.insert (i->first);
+  }
+  UpdateRoutes ();
+}
+
+void
+Spf::UpdateRoute (const std::string & prefix)
+{
+  NextHopSet nextHops;
+  std::map<std::string, MetricMap>::const_iterator origins = m_prefixOrigins.find (prefix);
+  uint32_t distance = SPF_INFINITY;
+  if (origins != m_prefixOrigins.end () && origins->second.count (m_root) == 0) {
+    distance = GetPrefixDistance (m_tree, origins->second);
+  }
+
+  if (distance != SPF_INFINITY) {
+    // (cost through the neighbor, neighbor) of the neighbors on a shortest
+    // path or closer to the prefix than we are
+    std::vector<std::pair<uint32_t, RouterHandle> > candidates;
+    for (std::map<RouterHandle, Tree>::const_iterator i = m_neighborTrees.begin (); i != m_neighborTrees.end (); i++) {
+      uint32_t link = GetLinkMetric (m_root, i->first);
+      uint32_t remaining = GetPrefixDistance (i->second, origins->second);
+      if (link == SPF_INFINITY || remaining == SPF_INFINITY) {
+        continue;
+      }
+      if (remaining < distance || link + remaining == distance) {
+        candidates.push_back (std::make_pair (link + remaining, i->first));
+      }
+    }
+    std::sort (candidates.begin (), candidates.end ());
+    for (uint32_t k = 0; k < candidates.size () && nextHops.size () < m_maxNextHops; k++) {
+      Ptr<Face> face = m_neighborFaces.find (m_routers[candidates[k].second].name)->second;
+      nextHops.insert (std::make_pair (face, candidates[k].first));
+    }
+  }
+  m_fibReconciler->SetNextHops (prefix, nextHops);
+}
+
+// ========== Class Spf::Tree ============
+
+Spf::Tree::Tree (const Spf * spf, RouterHandle root)
+  : m_spf (spf)
+  , m_root (root)
+  , m_run (0)
+{
+}
+
+void
+Spf::Tree::Build ()
+{
+  m_run++;
+  m_touched.clear ();
+  m_nodes.assign (m_spf->m_routers.size (), Node ());
+  if (m_root == NO_ROUTER) {
+    return;
+  }
+  m_nodes[m_root].distance = 0;
+  m_nodes[m_root].touched = m_run;
+  m_touched.push_back (m_root);
+  m_queue.push (std::make_pair (0, m_root));
+  Settle ();
+}
+
+void
+Spf::Tree::Repair (const std::vector<LinkChange> & changes)
+{
+  if (m_root == NO_ROUTER) {
+    return;
+  }
+  m_nodes.resize (m_spf->m_routers.size ());
+  m_run++;
+  m_cut.clear ();
+  m_touched.clear ();
+
+  // links of the tree that got longer: nothing below them keeps its distance
+  for (std::vector<LinkChange>::const_iterator c = changes.begin (); c != changes.end (); c++) {
+    if (c->newMetric > c->oldMetric && m_nodes[c->to].parent == c->from) {
+      CutSubtree (c->to);
+    }
+  }
+  for (std::vector<RouterHandle>::const_iterator x = m_cut.begin (); x != m_cut.end (); x++) {
+    m_nodes[*x].distance = SPF_INFINITY;
+    m_nodes[*x].parent = NO_ROUTER;
+    m_nodes[*x].children.clear ();
+  }
+  // grow them back from the routers around them, which kept their distance
+  for (std::vector<RouterHandle>::const_iterator x = m_cut.begin (); x != m_cut.end (); x++) {
+    const MetricMap & adjacency = m_spf->m_routers[*x].adjacency;
+    for (MetricMap::const_iterator y = adjacency.begin (); y != adjacency.end (); y++) {
+      if (m_nodes[y->first].touched != m_run && m_nodes[y->first].distance != SPF_INFINITY) {
+        uint32_t metric = m_spf->GetLinkMetric (y->first, *x);
+        if (metric != SPF_INFINITY) {
+          Relax (y->first, *x, metric);
+        }
+      }
+    }
+  }
+  // links that got shorter
+  for (std::vector<LinkChange>::const_iterator c = changes.begin (); c != changes.end (); c++) {
+    if (c->newMetric < c->oldMetric && m_nodes[c->from].distance != SPF_INFINITY) {
+      Relax (c->from, c->to, c->newMetric);
+    }
+  }
+  Settle ();
+}
+
+uint32_t
+Spf::Tree::GetDistance (RouterHandle router) const
+{
+  return router < m_nodes.size () ? m_nodes[router].distance : SPF_INFINITY;
+}
+
+RouterHandle
+Spf::Tree::GetFirstHop (RouterHandle router) const
+{
+  if (router == m_root || GetDistance (router) == SPF_INFINITY) {
+    return NO_ROUTER;
+  }
+  while (m_nodes[router].parent != m_root) {
+    router = m_nodes[router].parent;
+  }
+  return router;
+}
+
+const std::vector<RouterHandle> &
+Spf::Tree::GetTouched () const
+{
+  return m_touched;
+}
+
+void
+Spf::Tree::Settle ()
+{
+  while (!m_queue.empty ()) {
+    std::pair<uint32_t, RouterHandle> top = m_queue.top ();
+    m_queue.pop ();
+    if (top.first != m_nodes[top.second].distance) {
+      continue;  // improved since it was queued
+    }
+    const MetricMap & adjacency = m_spf->m_routers[top.second].adjacency;
+    for (MetricMap::const_iterator y = adjacency.begin (); y != adjacency.end (); y++) {
+      if (m_spf->m_routers[y->first].adjacency.count (top.second) != 0) {
+        Relax (top.second, y->first, y->second);
+      }
+    }
+  }
+}
+
+void
+Spf::Tree::CutSubtree (RouterHandle root)
+{
+  if (m_nodes[root].touched == m_run) {
+    return;  // below a link cut before
+  }
+  std::vector<RouterHandle> & siblings = m_nodes[m_nodes[root].parent].children;
+  siblings.erase (std::find (siblings.begin (), siblings.end (), root));
+
+  std::vector<RouterHandle> stack (1, root);
+  while (!stack.empty ()) {
+    RouterHandle x = stack.back ();
+    stack.pop_back ();
+    if (m_nodes[x].touched == m_run) {
+      continue;
+    }
+    m_nodes[x].touched = m_run;
+    m_cut.push_back (x);
+    m_touched.push_back (x);
+    stack.insert (stack.end (), m_nodes[x].children.begin (), m_nodes[x].children.end ());
+  }
+}
+
+void
+Spf::Tree::Relax (RouterHandle from, RouterHandle to, uint32_t metric)
+{
+  uint32_t distance = m_nodes[from].distance + metric;
+  if (distance >= m_nodes[to].distance) {
+    return;
+  }
+  SetParent (to, from);
+  m_nodes[to].distance = distance;
+  if (m_nodes[to].touched != m_run) {
+    m_nodes[to].touched = m_run;
+    m_touched.push_back (to);
+  }
+  m_queue.push (std::make_pair (distance, to));
+}
+
+void
+Spf::Tree::SetParent (RouterHandle router, RouterHandle parent)
+{
+  RouterHandle old = m_nodes[router].parent;
+  if (old == parent) {
+    return;
+  }
+  if (old != NO_ROUTER) {
+    std::vector<RouterHandle> & siblings = m_nodes[old].children;
+    siblings.erase (std::find (siblings.begin (), siblings.end (), router));
+  }
+  m_nodes[router].parent = parent;
+  m_nodes[parent].children.push_back (router);
+}
+
+} // namespace ndn
+} // namespace ns3
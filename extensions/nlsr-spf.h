@@ -0,0 +1,273 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// nlsr-spf.h
+
+#ifndef NLSR_SPF_H
+#define NLSR_SPF_H
+
+#include "nlsr-fib-reconciler.h"
+#include "nlsr-lsdb.h"
+#include "ns3/object.h"
+#include "ns3/ndn-face.h"
+#include "ns3/traced-callback.h"
+
+#include <functional>
+#include <map>
+#include <queue>
+#include <set>
+#include <vector>
+
+namespace ns3 {
+namespace ndn {
+
+static const uint32_t SPF_INFINITY = 0xFFFFFFFF;  // distance of an unreachable router
+static const uint32_t DEFAULT_MAX_NEXT_HOPS = 1;
+
+typedef uint32_t RouterHandle;  // interned router name, see Spf::InternRouter
+
+// ========== Class Spf ============
+
+/**
+ * @brief Shortest paths over the adjacencies of the LSUs in the Lsdb,
+ *        installed into the Fib for the prefixes they reach
+ *
+ * A link u -> v is used only if the LSU of u lists v and the LSU of v
+ * lists u, with the metric u gives it.  Shortest-path trees are kept
+ * between LSU changes, rooted at this router and at each neighbor it has
+ * a face to, and repaired dynamically: a changed LSU only touches the
+ * links to and from its router, so only the subtrees below tree links that
+ * got longer or went away are cut and grown back from their border, and
+ * only the routers a link that got shorter improves are relaxed.  The
+ * routes are then redone for the prefixes of the routers a repair touched.
+ * A link flap far from this router costs little more than the routers
+ * whose paths it is on, however large the network.
+ *
+ * A prefix is routed through up to MaxNextHops neighbors: the first hop
+ * of the shortest path, and the neighbors closer to the prefix than this
+ * router is, which cannot send an Interest back (the downstream
+ * criterion).  Each face is installed with the metric of the path through
+ * it, link plus the distance of the neighbor, so that the strategy ranks
+ * them by it.  The distance to a prefix is the lowest distance plus prefix
+ * metric of the routers announcing it; prefixes this router announces are
+ * left to its own applications.  The routes go to the Fib through a
+ * FibReconciler, one Commit per LSU change.
+ */
+class Spf : public Object {
+
+public:
+  Spf ();
+  virtual ~Spf ();
+
+  static TypeId
+  GetTypeId (void);
+
+  /// Root of the tree; set once, before SetLsdb
+  void
+  SetRouterName (const std::string & routerName);
+
+  void
+  SetFib (Ptr<Fib> fib);
+
+  Ptr<FibReconciler>
+  GetFibReconciler () const;
+
+  /**
+   * @brief Follow the changes of lsdb, starting with the LSUs it already
+   *        holds
+   */
+  void
+  SetLsdb (Ptr<Lsdb> lsdb);
+
+  /// The face that leads to the neighbor router, for the routes through it
+  void
+  SetNeighborFace (const std::string & neighbor, Ptr<Face> face);
+
+  void
+  RemoveNeighborFace (const std::string & neighbor);
+
+  uint32_t
+  GetMaxNextHops () const;
+
+  void
+  SetMaxNextHops (uint32_t maxNextHops);
+
+  /// SPF_INFINITY if router is unreachable or unknown
+  uint32_t
+  GetDistance (const std::string & router) const;
+
+  /// Neighbor on the shortest path to router, empty if there is none
+  std::string
+  GetNextHop (const std::string & router) const;
+
+  /// Face the prefix is routed to at the lowest metric, 0 if it has no route
+  Ptr<Face>
+  GetRoute (const std::string & prefix, uint32_t & cost) const;
+
+  /**
+   * @brief Lsdb "Changed" sink: replace the adjacencies and prefixes of
+   *        the router of key and repair the trees
+   */
+  void
+  OnLsuChanged (const std::string & key, Ptr<const LsuContent> oldLsu, Ptr<const LsuContent> newLsu);
+
+protected:
+  virtual void
+  DoDispose ();
+
+private:
+  typedef std::map<RouterHandle, uint32_t> MetricMap;  // neighbor or origin -> metric
+
+  struct Router
+  {
+    std::string name;
+    MetricMap adjacency;               // as its LSU lists them
+    std::vector<std::string> prefixes; // as its LSU lists them
+
+    Router (const std::string & n)
+    : name (n)
+    {}
+  };
+
+  // a link whose metric changed, SPF_INFINITY for a link that is absent
+  struct LinkChange
+  {
+    RouterHandle from;
+    RouterHandle to;
+    uint32_t oldMetric;
+    uint32_t newMetric;
+
+    LinkChange (RouterHandle f, RouterHandle t, uint32_t o, uint32_t n)
+    : from (f), to (t), oldMetric (o), newMetric (n)
+    {}
+  };
+
+  static const RouterHandle NO_ROUTER = 0xFFFFFFFF;
+
+  // shortest-path tree from one router over the links of m_routers
+  class Tree
+  {
+  public:
+    Tree (const Spf * spf, RouterHandle root);
+
+    /// Grow the tree from scratch
+    void
+    Build ();
+
+    /// Fix the tree after the links changed by changes
+    void
+    Repair (const std::vector<LinkChange> & changes);
+
+    uint32_t
+    GetDistance (RouterHandle router) const;
+
+    /// First hop from the root towards router, NO_ROUTER if none
+    RouterHandle
+    GetFirstHop (RouterHandle router) const;
+
+    /// Routers whose distance or parent the last Build or Repair changed
+    const std::vector<RouterHandle> &
+    GetTouched () const;
+
+  private:
+    struct Node
+    {
+      uint32_t distance;
+      RouterHandle parent;  // NO_ROUTER at the root and when unreachable
+      std::vector<RouterHandle> children;
+      uint32_t touched;     // m_run when last cut or relaxed
+
+      Node ()
+      : distance (SPF_INFINITY), parent (NO_ROUTER), touched (0)
+      {}
+    };
+
+    void
+    CutSubtree (RouterHandle root);
+
+    void
+    Relax (RouterHandle from, RouterHandle to, uint32_t metric);
+
+    void
+    SetParent (RouterHandle router, RouterHandle parent);
+
+    /// Dijkstra over the routers queued
+    void
+    Settle ();
+
+  private:
+    const Spf * m_spf;
+    RouterHandle m_root;
+    std::vector<Node> m_nodes;  // by RouterHandle, grown as routers are interned
+    uint32_t m_run;             // count of builds and repairs
+    std::vector<RouterHandle> m_cut;
+    std::vector<RouterHandle> m_touched;
+    std::priority_queue<std::pair<uint32_t, RouterHandle>,
+                        std::vector<std::pair<uint32_t, RouterHandle> >,
+                        std::greater<std::pair<uint32_t, RouterHandle> > > m_queue;
+  };
+
+  RouterHandle
+  InternRouter (const std::string & name);
+
+  /// Metric of the link from -> to, SPF_INFINITY unless both list the other
+  uint32_t
+  GetLinkMetric (RouterHandle from, RouterHandle to) const;
+
+  /// Lowest distance plus metric from the root of tree to an origin
+  uint32_t
+  GetPrefixDistance (const Tree & tree, const MetricMap & origins) const;
+
+  /// Collect the prefixes of the routers tree touched
+  void
+  MarkTouched (const Tree & tree);
+
+  void
+  UpdateRoutes ();
+
+  void
+  UpdateAllRoutes ();
+
+  void
+  UpdateRoute (const std::string & prefix);
+
+private:
+  std::vector<Router> m_routers;
+  std::map<std::string, RouterHandle> m_routerHandles;
+  RouterHandle m_root;
+  Tree m_tree;                                // from this router
+  std::map<RouterHandle, Tree> m_neighborTrees;  // from each neighbor with a face
+  std::map<std::string, MetricMap> m_prefixOrigins;  // prefix -> routers announcing it
+  std::map<std::string, Ptr<Face> > m_neighborFaces;
+  Ptr<FibReconciler> m_fibReconciler;
+  Ptr<Lsdb> m_lsdb;
+  uint32_t m_maxNextHops;
+
+  std::set<std::string> m_dirtyPrefixes;  // routes to redo after the repair
+
+  // routers whose distance or parent the repair of our own tree changed
+  TracedCallback<uint32_t> m_repaired;
+
+}; // class Spf
+
+} // namespace ndn
+} // namespace ns3
+
+#endif // NLSR_SPF_H
@@ -0,0 +1,208 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2011-2012 University of California, Los Angeles
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope tha t it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn> 
+ */
+
+// nlsr-tlv.h
+
+#ifndef NLSR_TLV_H
+#define NLSR_TLV_H
+
+#include "ns3/assert.h"
+#include "ns3/buffer.h"
+
+namespace ns3 {
+namespace ndn {
+namespace tlv {
+
+// Every NLSR message starts with a U32 word holding its length.  The top
+// byte of that word, always zero in the original fixed-width format, now
+// carries the encoding:
+//
+//   LEGACY_ENCODING  U16 section and string lengths, as before
+//   VARNUM_ENCODING  the body is a sequence of <type><length><value> blocks
+//                    whose type and length are NDN-TLV VAR-NUMBERs; blocks
+//                    of unknown type are skipped
+//
+// so old messages stay decodable and the body may grow to MAX_MESSAGE_SIZE.
+// A name list has no sections: its body is the names, each behind a U16
+// or a VAR-NUMBER length in the two encodings above.  Name lists have one
+// more:
+//
+//   FRONT_CODED_ENCODING  every name is <shared><suffix length><suffix>, the
+//                         first two VAR-NUMBERs; the name is the first
+//                         <shared> bytes of the previous name plus the suffix
+
+static const uint8_t LEGACY_ENCODING = 0;
+static const uint8_t VARNUM_ENCODING = 1;
+static const uint8_t FRONT_CODED_ENCODING = 2;
+static const uint32_t MAX_MESSAGE_SIZE = 0x00FFFFFF;
+static const uint32_t MAX_LEGACY_LENGTH = 0xFFFF;  // largest U16 section or string
+
+enum BlockType
+{
+  LIFETIME = 1,
+  ADJACENCY_LIST = 2,
+  REACHABILITY_LIST = 3,
+  ROUTER_NAME = 4,
+  NEIGHBOR_LIST = 5,
+  DEAD_TIME = 6,
+  HELLO_VERSION = 7,
+  BASE_VERSION = 8,
+  ADJACENCY_CHANGES = 9,
+  REACHABILITY_CHANGES = 10,
+  SYNC_DIGEST = 11
+};
+
+inline uint32_t
+MakeLengthWord (uint8_t encoding, uint32_t size)
+{
+  NS_ASSERT (size <= MAX_MESSAGE_SIZE);
+  return (uint32_t (encoding) << 24) | size;
+}
+
+inline uint8_t
+GetEncoding (uint32_t lengthWord)
+{
+  return lengthWord >> 24;
+}
+
+inline uint32_t
+GetLength (uint32_t lengthWord)
+{
+  return lengthWord & MAX_MESSAGE_SIZE;
+}
+
+/// Bytes taken by n as a VAR-NUMBER: 1, or a 253/254/255 marker plus 2/4/8
+inline uint32_t
+VarNumberSize (uint64_t n)
+{
+  if (n < 253) {
+    return 1;
+  } else if (n <= 0xFFFF) {
+    return 3;
+  } else if (n <= 0xFFFFFFFF) {
+    return 5;
+  }
+  return 9;
+}
+
+inline void
+WriteVarNumber (Buffer::Iterator & i, uint64_t n)
+{
+  if (n < 253) {
+    i.WriteU8 (n);
+  } else if (n <= 0xFFFF) {
+    i.WriteU8 (253);
+    i.WriteHtonU16 (n);
+  } else if (n <= 0xFFFFFFFF) {
+    i.WriteU8 (254);
+    i.WriteHtonU32 (n);
+  } else {
+    i.WriteU8 (255);
+    i.WriteHtonU64 (n);
+  }
+}
+
+inline uint64_t
+ReadVarNumber (Buffer::Iterator & i)
+{
+  uint8_t first = i.ReadU8 ();
+  switch (first) {
+  case 253:
+    return i.ReadNtohU16 ();
+  case 254:
+    return i.ReadNtohU32 ();
+  case 255:
+    return i.ReadNtohU64 ();
+  default:
+    return first;
+  }
+}
+
+/// Bounds-checked ReadVarNumber from the next left bytes of i; takes the bytes read off left
+inline bool
+ReadVarNumber (Buffer::Iterator & i, uint64_t & left, uint64_t & n)
+{
+  if (left < 1) {
+    return false;
+  }
+  uint8_t first = i.ReadU8 ();
+  uint32_t size = first < 253 ? 0 : (first == 253 ? 2 : (first == 254 ? 4 : 8));
+  if (left - 1 < size) {
+    return false;
+  }
+  left -= 1 + size;
+  switch (first) {
+  case 253:
+    n = i.ReadNtohU16 ();
+    break;
+  case 254:
+    n = i.ReadNtohU32 ();
+    break;
+  case 255:
+    n = i.ReadNtohU64 ();
+    break;
+  default:
+    n = first;
+  }
+  return true;
+}
+
+/// Bounds-checked ReadVarNumber over a contiguous buffer; advances pos
+inline bool
+ReadVarNumber (const uint8_t *& pos, const uint8_t * end, uint64_t & n)
+{
+  if (pos == end) {
+    return false;
+  }
+  uint32_t size = *pos < 253 ? 1 : (*pos == 253 ? 3 : (*pos == 254 ? 5 : 9));
+  if (uint32_t (end - pos) < size) {
+    return false;
+  }
+  if (size == 1) {
+    n = *pos;
+  } else {
+    n = 0;
+    for (uint32_t k = 1; k < size; k++) {
+      n = (n << 8) | pos[k];
+    }
+  }
+  pos += size;
+  return true;
+}
+
+/// Size of a whole block with a value of length bytes
+inline uint32_t
+BlockSize (uint32_t type, uint64_t length)
+{
+  return VarNumberSize (type) + VarNumberSize (length) + length;
+}
+
+inline void
+WriteBlockHeader (Buffer::Iterator & i, uint32_t type, uint64_t length)
+{
+  WriteVarNumber (i, type);
+  WriteVarNumber (i, length);
+}
+
+} // namespace tlv
+} // namespace ndn
+} // namespace ns3
+
+#endif /* NLSR_TLV_H */
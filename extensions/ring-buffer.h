@@ -0,0 +1,221 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// ring-buffer.h
+
+#ifndef _RING_BUFFER_H
+#define _RING_BUFFER_H
+
+#include "ns3/assert.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace ns3 {
+namespace ndn {
+
+/// ========== Class RingBuffer ============
+
+/**
+ * @brief Fixed-capacity circular buffer addressed by absolute position
+ *
+ * Every pushed element gets a position that grows by one per Push and is
+ * never reused, so a position stays a valid handle until the element is
+ * evicted (Contains () tells whether it still is).  Once the buffer is
+ * full, Push overwrites the oldest slot in place; slots are allocated
+ * lazily up to the capacity and then reused, so the steady state does not
+ * allocate.
+ */
+template<class T>
+class RingBuffer {
+
+public:
+  typedef uint64_t Position;
+
+  RingBuffer (uint32_t capacity = 1)
+  : m_capacity (capacity), m_begin (0), m_end (0)
+  {
+    NS_ASSERT (capacity > 0);
+  }
+
+  uint32_t
+  GetCapacity () const
+  {
+    return m_capacity;
+  }
+
+  /**
+   * @brief Change the capacity, keeping the newest min (Size (), capacity)
+   *        elements at their current positions
+   */
+  void
+  SetCapacity (uint32_t capacity)
+  {
+    NS_ASSERT (capacity > 0);
+    std::vector<T> slots;
+    slots.reserve (std::min<uint64_t> (Size (), capacity));
+
+    Position begin = m_end - std::min<uint64_t> (Size (), capacity);
+    for (Position p = begin; p != m_end; p++) {
+      slots.push_back ((*this)[p]);
+    }
+
+    m_slots.clear ();
+    m_capacity = capacity;
+    m_begin = begin;
+    // re-home the surviving elements so that position p lives in slot p % capacity
+    for (Position p = m_begin; p != m_end; p++) {
+      Slot (p) = slots[p - m_begin];
+    }
+  }
+
+  uint32_t
+  Size () const
+  {
+    return m_end - m_begin;
+  }
+
+  bool
+  Empty () const
+  {
+    return m_begin == m_end;
+  }
+
+  bool
+  Full () const
+  {
+    return Size () == m_capacity;
+  }
+
+  /// Position of the oldest element
+  Position
+  Begin () const
+  {
+    return m_begin;
+  }
+
+  /// Position one past the newest element
+  Position
+  End () const
+  {
+    return m_end;
+  }
+
+  bool
+  Contains (Position p) const
+  {
+    return p >= m_begin && p < m_end;
+  }
+
+  T &
+  operator[] (Position p)
+  {
+    NS_ASSERT (Contains (p));
+    return m_slots[SlotIndex (p)];
+  }
+
+  const T &
+  operator[] (Position p) const
+  {
+    NS_ASSERT (Contains (p));
+    return m_slots[SlotIndex (p)];
+  }
+
+  T &
+  Newest ()
+  {
+    NS_ASSERT (!Empty ());
+    return (*this)[m_end - 1];
+  }
+
+  const T &
+  Newest () const
+  {
+    NS_ASSERT (!Empty ());
+    return (*this)[m_end - 1];
+  }
+
+  T &
+  Oldest ()
+  {
+    NS_ASSERT (!Empty ());
+    return (*this)[m_begin];
+  }
+
+  /**
+   * @brief Append a new element and return its slot for the caller to fill
+   *
+   * If the buffer is full the oldest element is evicted and its slot (with
+   * whatever it still holds) is returned.  Callers that need to know what is
+   * evicted should look at Oldest () before pushing.
+   */
+  T &
+  Push ()
+  {
+    if (Full ()) {
+      m_begin++;
+    }
+    return Slot (m_end++);
+  }
+
+  /// Drop the oldest element; its slot is kept for reuse
+  void
+  PopOldest ()
+  {
+    NS_ASSERT (!Empty ());
+    m_begin++;
+  }
+
+  void
+  Clear ()
+  {
+    m_slots.clear ();
+    m_begin = m_end;
+  }
+
+private:
+  uint32_t
+  SlotIndex (Position p) const
+  {
+    return p % m_capacity;
+  }
+
+  // slot for position p, growing the storage on first use
+  T &
+  Slot (Position p)
+  {
+    uint32_t index = SlotIndex (p);
+    if (index >= m_slots.size ()) {
+      m_slots.resize (index + 1);
+    }
+    return m_slots[index];
+  }
+
+private:
+  std::vector<T> m_slots;
+  uint32_t m_capacity;
+  Position m_begin;
+  Position m_end;
+}; // class RingBuffer
+
+} // namespace ndn
+} // namespace ns3
+
+#endif /* _RING_BUFFER_H */
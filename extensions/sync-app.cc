@@ -21,6 +21,7 @@
 // nlsr-app.cc
 
 #include "sync-app.h"
+#include "nlsr-tlv.h"
 #include "ns3/ptr.h"
 #include "ns3/log.h"
 #include "ns3/simulator.h"
@@ -32,8 +33,17 @@
 #include "ns3/ndn-data.h"
 
 #include "ns3/ndn-fib.h"
+#include "ns3/ndn-l3-protocol.h"
+#include "ns3/ndn-net-device-face.h"
+#include "ns3/channel.h"
+#include "ns3/node.h"
 #include "ns3/random-variable.h"
+#include "ns3/uinteger.h"
+#include "ns3/boolean.h"
+#include "ns3/double.h"
+#include "ns3/trace-source-accessor.h"
 
+#include <algorithm>
 #include <sstream>
 
 NS_LOG_COMPONENT_DEFINE ("SyncApp");
@@ -45,9 +55,11 @@ NS_OBJECT_ENSURE_REGISTERED (SyncApp);
 
 
 SyncApp::SyncApp ()
+  : m_suppressedInterests (0)
+  , m_lsuSeq (0)
+  , m_previousLsuSeq (0)
 {
   m_seq = 1;
-  m_outstandingDigest = 0;
 }
 
 // register NS-3 type
@@ -57,6 +69,84 @@ SyncApp::GetTypeId ()
   static TypeId tid = TypeId ("SyncApp")
     .SetParent<ndn::App> ()
     .AddConstructor<SyncApp> ()
+    .AddAttribute ("MaxLogLength", "Number of entries kept in the digest log",
+                   UintegerValue (DEFAULT_MAX_LOG_LENGTH),
+                   MakeUintegerAccessor (&SyncApp::SetDigestLogLength, &SyncApp::GetDigestLogLength),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MaxLogChanges", "Number of per-name changes kept for the entries of the digest log",
+                   UintegerValue (DEFAULT_MAX_LOG_CHANGES),
+                   MakeUintegerAccessor (&SyncApp::SetDigestLogChanges, &SyncApp::GetDigestLogChanges),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("IbfReconciliation", "Recover from unknown digests by exchanging IBFs instead of full state",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&SyncApp::m_ibfReconciliation),
+                   MakeBooleanChecker ())
+    .AddAttribute ("IbfCells", "Number of cells of the IBF over the name state",
+                   UintegerValue (DEFAULT_IBF_CELLS),
+                   MakeUintegerAccessor (&SyncApp::SetIbfSize, &SyncApp::GetIbfSize),
+                   MakeUintegerChecker<uint32_t> (InvertibleBloomFilter::HASH_COUNT))
+    .AddAttribute ("ReplyCacheSize", "Number of encoded sync replies kept for repeated requests (0 disables)",
+                   UintegerValue (DEFAULT_REPLY_CACHE_SIZE),
+                   MakeUintegerAccessor (&SyncApp::SetReplyCacheSize, &SyncApp::GetReplyCacheSize),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("FrontCodedNames", "Send sync replies as sorted, front-coded name lists",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&SyncApp::m_frontCodedNames),
+                   MakeBooleanChecker ())
+    .AddAttribute ("SegmentSize", "Largest number of bytes of names in one segment of a sync reply",
+                   UintegerValue (DEFAULT_SEGMENT_SIZE),
+                   MakeUintegerAccessor (&SyncApp::m_segmentSize),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("SegmentPipeline", "Number of segment Interests kept in flight while fetching a segmented reply",
+                   UintegerValue (DEFAULT_SEGMENT_PIPELINE),
+                   MakeUintegerAccessor (&SyncApp::m_segmentPipeline),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("CoalescingWindow", "Updates arriving within this time of each other are advertised with a single sync Interest (0 disables)",
+                   TimeValue (MilliSeconds (0)),
+                   MakeTimeAccessor (&SyncApp::m_coalescingWindow),
+                   MakeTimeChecker ())
+    .AddAttribute ("CoalescingMaxDelay", "Longest time an update is held back by the coalescing window",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&SyncApp::m_coalescingMaxDelay),
+                   MakeTimeChecker ())
+    .AddAttribute ("SyncIntervalMin", "Interval of the periodic sync Interest after a divergence",
+                   TimeValue (Seconds (1.0)),
+                   MakeTimeAccessor (&SyncApp::m_syncIntervalMin),
+                   MakeTimeChecker ())
+    .AddAttribute ("SyncIntervalMax", "Longest interval of the periodic sync Interest while synced",
+                   TimeValue (Seconds (30.0)),
+                   MakeTimeAccessor (&SyncApp::m_syncIntervalMax),
+                   MakeTimeChecker ())
+    .AddAttribute ("SyncIntervalJitter", "Random variation of the periodic sync interval, as a fraction of it",
+                   DoubleValue (0.2),
+                   MakeDoubleAccessor (&SyncApp::m_syncIntervalJitter),
+                   MakeDoubleChecker<double> (0.0, 1.0))
+    .AddAttribute ("DigestInHello", "Carry the sync digest in the hellos and sync with a neighbor only when its digest differs, instead of sending periodic sync Interests",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&SyncApp::m_digestInHello),
+                   MakeBooleanChecker ())
+    .AddAttribute ("HelloInterval", "Time between the hellos to each neighbor",
+                   TimeValue (Seconds (DEFAULT_HELLO_INTERVAL)),
+                   MakeTimeAccessor (&SyncApp::m_helloInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("DeadTime", "Seconds without a hello after which the neighbors take us for dead",
+                   UintegerValue (DEFAULT_DEAD_TIME),
+                   MakeUintegerAccessor (&SyncApp::m_deadTime),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MaxNextHops", "Number of loop-free next hops the node routes a prefix through at most",
+                   UintegerValue (DEFAULT_MAX_NEXT_HOPS),
+                   MakeUintegerAccessor (&SyncApp::m_maxNextHops),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("LsuLifetime", "Lifetime in seconds of the LSUs we originate; they are refreshed at half of it",
+                   UintegerValue (DEFAULT_LSU_LIFETIME),
+                   MakeUintegerAccessor (&SyncApp::m_lsuLifetime),
+                   MakeUintegerChecker<uint32_t> (2))
+    .AddAttribute ("NameLifetime", "Time after its last update an id is tombstoned, and again until the tombstone is dropped (0 disables); the LSU keys never expire, the LSDB ages them",
+                   TimeValue (Seconds (0)),
+                   MakeTimeAccessor (&SyncApp::SetNameLifetime, &SyncApp::GetNameLifetime),
+                   MakeTimeChecker ())
+    .AddTraceSource ("SuppressedInterests", "Number of sync Interests saved by coalescing updates",
+                     MakeTraceSourceAccessor (&SyncApp::m_suppressedInterests))
     ;
   return tid;
 }
@@ -78,12 +168,48 @@ SyncApp::StartApplication ()
   // Note that ``m_face`` is cretaed by ndn::App
   Ptr<ndn::fib::Entry> fibEntry = fib->Add (*prefix, m_face, 0);
 
-  std::stringstream ss;
-  ss << GetNode ()-> GetId ();
-  SetRouterName ("router-" +  ss.str());
+  SetRouterName (MakeRouterName (GetNode ()));
   NS_LOG_DEBUG ("Starting ... Router: " << GetRouterName ());
 
-  Simulator::Schedule (Seconds (0.0), &SyncApp::PeriodicalSyncInterest, this);
+  // one LSDB per node, and the routing computation following it
+  m_lsdb = GetNode ()->GetObject<Lsdb> ();
+  if (m_lsdb == 0) {
+    m_lsdb = CreateObject<Lsdb> ();
+    GetNode ()->AggregateObject (m_lsdb);
+  }
+  m_spf = GetNode ()->GetObject<Spf> ();
+  if (m_spf == 0) {
+    m_spf = CreateObject<Spf> ();
+    m_spf->SetRouterName (GetRouterName ());
+    m_spf->SetMaxNextHops (m_maxNextHops);
+    m_spf->SetFib (fib);
+    m_spf->SetLsdb (m_lsdb);
+    GetNode ()->AggregateObject (m_spf);
+    GetNode ()->AggregateObject (m_spf->GetFibReconciler ());
+  }
+
+  // adjacencies come and go with the hellos
+  m_hello = CreateObject<HelloProtocol> ();
+  m_hello->SetRouterName (GetRouterName ());
+  m_hello->SetHelloInterval (m_helloInterval);
+  m_hello->SetDeadTime (m_deadTime);
+  m_hello->SetSendCallbacks (MakeCallback (&SyncApp::SendHelloInterest, this),
+                             MakeCallback (&SyncApp::SendSyncData, this));
+  m_hello->SetAdjacencyCallback (MakeCallback (&SyncApp::OnAdjacencyChanged, this));
+  if (m_digestInHello) {
+    m_hello->SetDigestCallbacks (MakeCallback (&SyncApp::GetHelloDigest, this),
+                                 MakeCallback (&SyncApp::OnNeighborDigest, this));
+  }
+  fib->Add (ndn::Name (HELLO_PREFIX + "/" + GetRouterName ()), m_face, 0);
+  DiscoverNeighbors ();
+  m_hello->Start ();
+
+  m_syncInterval = m_syncIntervalMin;
+  m_syncChanged = false;
+  if (!m_digestInHello) {
+    m_syncEvent = Simulator::Schedule (Seconds (0.0), &SyncApp::PeriodicalSyncInterest, this);
+  }
+  m_lsuRefreshEvent = Simulator::Schedule (Seconds (0.0), &SyncApp::OriginateLsu, this);
 
   Simulator::Schedule (Seconds (1), &SyncApp::GenerateNewUpdate, this);
 }
@@ -92,6 +218,24 @@ SyncApp::StartApplication ()
 void
 SyncApp::StopApplication ()
 {
+  Simulator::Cancel (m_flushEvent);
+  Simulator::Cancel (m_syncEvent);
+  Simulator::Cancel (m_expiryEvent);
+  Simulator::Cancel (m_lsuRefreshEvent);
+  m_hello->Stop ();
+  for (LsuFetchMap::iterator i = m_lsuFetches.begin (); i != m_lsuFetches.end (); i++) {
+    Simulator::Cancel (i->second.timeout);
+  }
+  m_lsuFetches.clear ();
+  for (ReassemblyMap::iterator i = m_reassembly.begin (); i != m_reassembly.end (); i++) {
+    Simulator::Cancel (i->second.timeout);
+  }
+  m_reassembly.clear ();
+  for (HeldReplyMap::iterator i = m_heldReplies.begin (); i != m_heldReplies.end (); i++) {
+    Simulator::Cancel (i->second.expiry);
+  }
+  m_heldReplies.clear ();
+
   // cleanup ndn::App
   ndn::App::StopApplication ();
 }
@@ -101,6 +245,28 @@ void
 SyncApp::OnInterest (Ptr<const ndn::Interest> interest)
 {
   Ptr<const ndn::Name> name = interest->GetNamePtr ();
+  if (IsIbfName (name)) {
+    OnIbfInterest (interest);
+    return;
+  }
+  if (HelloProtocol::IsHelloName (name)) {
+    m_hello->OnHelloInterest (interest);
+    return;
+  }
+  if (IsLsuName (name)) {
+    OnLsuInterest (interest);
+    return;
+  }
+
+  ReplyKey key;
+  uint32_t segment = 0;
+  if (GetSegmentFromName (name, key, segment)) {
+    NS_LOG_DEBUG ("Receive Segment Interest: " << key.digest1 << " " << key.digest2 << " " << segment);
+    if ( IsPacketDropped () ) { NS_LOG_DEBUG ("Segment Interest Packet Lost !"); return; }
+    SendSegment (key, segment);
+    return;
+  }
+
   uint64_t digest1 = 0;
   uint64_t digest2 = 0;
   GetDigestFromName (name, digest1, digest2);
@@ -112,17 +278,22 @@ SyncApp::OnInterest (Ptr<const ndn::Interest> interest)
   if (digest2 == 0) {
     if (GetCurrentDigest () == digest1) {
       NS_LOG_DEBUG ("============= Synced! ============" << digest1);
-      SetOutstandingDigest (digest1);
+      AddOutstandingDigest (digest1, interest->GetInterestLifetime ());
     } else {
       if (IsDigestInLog (digest1)) {
         NS_LOG_DEBUG ("============= Known! =============" << digest1);
         SendUpdateInbetween (digest1, GetCurrentDigest ());
       } else {
         NS_LOG_DEBUG ("============= Unknown! ============" << digest1);
-        if (digest1 == GetUnknownDigest ()) { // This is a temporary solution, may lead to a deadlock
+        ResetSyncInterval ();
+        if (m_ibfReconciliation) {
+          SendIbfInterest (digest1);
+          return;
+        }
+        if (IsUnknownDigest (digest1)) { // This is a temporary solution, may lead to a deadlock
           SendSyncInterest (INITIAL_DIGEST, digest1);
         }
-        SetUnknownDigest (digest1);
+        AddUnknownDigest (digest1);
         SendSyncInterest (GetSyncDigest (), digest1);
       }
     }
@@ -132,6 +303,7 @@ SyncApp::OnInterest (Ptr<const ndn::Interest> interest)
         SendUpdateInbetween (digest1, digest2);
     } else {
         NS_LOG_DEBUG ("=========== Cannot Resync! ===========" << digest1 << " " << digest2);
+        ResetSyncInterval ();
     } 
   }
 }
@@ -145,36 +317,64 @@ SyncApp::OnData (Ptr<const ndn::Data> data)
     NS_LOG_DEBUG ("Data Packet Lost!");
     return;
   }
-  uint64_t digest1, digest2;
-  GetDigestFromName (data->GetNamePtr (), digest1, digest2);
-
-  NS_LOG_DEBUG ("Receiving Data packet: " << digest1 <<  " " << digest2);
+  if (HelloProtocol::IsHelloName (data->GetNamePtr ())) {
+    m_hello->OnHelloData (data);
+    return;
+  }
+  if (IsLsuName (data->GetNamePtr ())) {
+    OnLsuData (data);
+    return;
+  }
 
-  Ptr<Packet> payload = data->GetPayload ()->Copy ();    
-  NameListHeader nameList;
-  payload->RemoveHeader (nameList);
-  nameList.Print(std::cout);
-  std::vector<std::string> newNameList;
-  bool hasNew = false;
+  // one flat copy of the payload; the names are parsed in place from it
+  Ptr<const Packet> payload = data->GetPayload ();
+  m_rxBuffer.resize (std::max<uint32_t> (payload->GetSize (), 1));
+  uint32_t size = payload->CopyData (&m_rxBuffer[0], payload->GetSize ());
 
-  for (std::vector<std::string>::const_iterator i = nameList.GetNameList ().begin ();
-       i != nameList.GetNameList ().end ();
-       i++) 
-  {
-    std::string oldName;
-    if (Update (*i, oldName) == true) {
-      hasNew = true;
-      newNameList.push_back (*i);
+  // IBF replies are segmented like the others, but have their own key
+  ReplyKey key;
+  uint32_t segment = 0;
+  if (GetSegmentFromName (data->GetNamePtr (), key, segment) == false) {
+    if (IsIbfName (data->GetNamePtr ())) {
+      if (GetIbfKeyFromName (data->GetNamePtr (), key) == false) {
+        NS_LOG_DEBUG ("Malformed IBF reply name: " << data->GetName ());
+        return;
+      }
+    } else {
+      GetDigestFromName (data->GetNamePtr (), key.digest1, key.digest2);
     }
   }
 
-  if (hasNew) OnNewUpdate ();
+  NS_LOG_DEBUG ("Receiving " << (key.ibf ? "IBF reply" : "Data packet") << ": "
+                << key.digest1 <<  " " << key.digest2 << " segment " << segment);
+  SegmentHeader segmentHeader;
+  uint32_t offset = segmentHeader.Parse (&m_rxBuffer[0], size);
+  if (offset == 0 || segment > segmentHeader.GetFinalSegment ()) {
+    NS_LOG_DEBUG ("Malformed segment in " << data->GetName ());
+    return;
+  }
+
+  if (m_rxNameList.Parse (&m_rxBuffer[0] + offset, size - offset) == false) {
+    NS_LOG_DEBUG ("Malformed name list in " << data->GetName ());
+    return;
+  }
+
+  if (segmentHeader.GetFinalSegment () > 0) {
+    OnSegment (key, segment, segmentHeader.GetFinalSegment ());
+    return;
+  }
+
+  // the whole reply is one digest step
+  if (Update (m_rxNameList.GetNameList ())) {
+    ResetSyncInterval ();
+    OnNewUpdate ();
+  }
 }
 
 void
-SyncApp::SendSyncInterest (uint64_t digest1, uint64_t digest2)
+SyncApp::SendSyncInterest (uint64_t digest1, uint64_t digest2, Time lifetime)
 {
-  const Ptr<ndn::Interest> interest = BuildSyncInterest (digest1, digest2);
+  const Ptr<ndn::Interest> interest = BuildSyncInterest (digest1, digest2, lifetime);
 
   NS_LOG_DEBUG ("Sending Sync Interest: " << digest1 << " " << digest2);
   
@@ -188,9 +388,48 @@ SyncApp::SendSyncInterest (uint64_t digest1, uint64_t digest2)
 void
 SyncApp::PeriodicalSyncInterest ()
 {
-  SendSyncInterest (GetCurrentDigest (), 0);
+  // keep the Interest parked at the neighbours until the next one replaces it
+  Time lifetime = Max (Seconds (SYNC_INTEREST_LIFETIME),
+                       Seconds (m_syncInterval.GetSeconds () * (1 + m_syncIntervalJitter)));
+  SendSyncInterest (GetCurrentDigest (), 0, lifetime);
 
-  Simulator::Schedule (Seconds (3), &SyncApp::PeriodicalSyncInterest, this);
+  ScheduleSyncInterest ();
+  // no new names and no divergence since the last one: back off
+  if (!m_syncChanged) {
+    m_syncInterval = Min (Seconds (m_syncInterval.GetSeconds () * BACKOFF_FACTOR), m_syncIntervalMax);
+  }
+  m_syncChanged = false;
+}
+
+void
+SyncApp::ScheduleSyncInterest ()
+{
+  // the hellos compare digests with the neighbors instead
+  if (m_digestInHello) {
+    return;
+  }
+
+  UniformVariable rand (1 - m_syncIntervalJitter, 1 + m_syncIntervalJitter);
+  Time delay = Seconds (m_syncInterval.GetSeconds () * rand.GetValue ());
+
+  NS_LOG_DEBUG ("Next periodic sync Interest in " << delay.GetSeconds () << "s");
+  Simulator::Cancel (m_syncEvent);
+  m_syncEvent = Simulator::Schedule (delay, &SyncApp::PeriodicalSyncInterest, this);
+}
+
+void
+SyncApp::ResetSyncInterval ()
+{
+  m_syncChanged = true;
+
+  // already at the short interval: rescheduling again would only keep
+  // postponing the next Interest under a stream of divergences
+  if (m_syncInterval <= m_syncIntervalMin) {
+    return;
+  }
+  NS_LOG_DEBUG ("New names or divergence, periodic sync interval reset");
+  m_syncInterval = m_syncIntervalMin;
+  ScheduleSyncInterest ();
 }
 
 void
@@ -208,18 +447,433 @@ SyncApp::SendSyncData (Ptr<ndn::Data> data)
 void
 SyncApp::SendUpdateInbetween (uint64_t digest1, uint64_t digest2)
 {
-  Ptr<NameListHeader> lsuNameList = Create<NameListHeader> ();
-  if (GetUpdateInbetween (digest1, digest2, lsuNameList->Get ()) == false)
+  // both ends are in the log, so the reply cannot have changed since it was cached
+  const Segments * cached = LookupReply (digest1, digest2);
+  if (cached != 0) {
+    NS_LOG_DEBUG ("Sending cached Data:" << digest1 << " " << digest2);
+    SendSyncData (cached->front ());
     return;
+  }
 
-  Ptr<Packet> packet = Create<Packet> ();
-  packet->AddHeader (*lsuNameList);
+  NameList nameList;
+  if (GetUpdateInbetween (digest1, digest2, nameList) == false)
+    return;
 
-  Ptr<ndn::Data> data = Create<ndn::Data> (packet);
-  data->SetName (MakeSyncName (digest1, digest2));
-  NS_LOG_DEBUG ("Sending Data:" << digest1 << " " << digest2);
+  SendNameList (digest1, digest2, nameList);
+}
 
-  SendSyncData (data);
+void
+SyncApp::SendUpdatesInbetween (const std::vector<uint64_t> & digests, uint64_t digest2)
+{
+  std::vector<uint64_t> misses;
+  for (std::vector<uint64_t>::const_iterator i = digests.begin (); i != digests.end (); i++) {
+    const Segments * cached = LookupReply (*i, digest2);
+    if (cached != 0) {
+      NS_LOG_DEBUG ("Sending cached Data:" << *i << " " << digest2);
+      SendSyncData (cached->front ());
+    } else {
+      misses.push_back (*i);
+    }
+  }
+  if (misses.empty ()) {
+    return;
+  }
+
+  std::map<uint64_t, NameList> updates;
+  GetUpdatesInbetween (misses, digest2, updates);
+  for (std::map<uint64_t, NameList>::iterator i = updates.begin (); i != updates.end (); i++) {
+    SendNameList (i->first, digest2, i->second);
+  }
+}
+
+void
+SyncApp::SendNameList (uint64_t digest1, uint64_t digest2, NameList & nameList)
+{
+  Segments segments;
+  ReplyKey key (digest1, digest2);
+  MakeSegments (key, nameList, segments);
+  NS_LOG_DEBUG ("Sending Data:" << digest1 << " " << digest2 << " in " << segments.size () << " segments");
+
+  // only the first segment goes out unasked; the requester pulls the rest
+  CacheReply (digest1, digest2, segments);
+  if (segments.size () > 1) {
+    HoldReply (key, segments);
+  }
+  SendSyncData (segments.front ());
+}
+
+void
+SyncApp::MakeSegments (const ReplyKey & key, NameList & nameList, Segments & segments) const
+{
+  // any node holding both digests must cut the same reply into the same
+  // segments, so the names are put in a canonical order first (the one
+  // front coding wants, too)
+  std::sort (nameList.begin (), nameList.end ());
+
+  std::vector<Ptr<NameListHeader> > parts;
+  NameList::const_iterator begin = nameList.begin ();
+  do {
+    Ptr<NameListHeader> part = Create<NameListHeader> ();
+    SetNameListEncoding (*part);
+
+    // at least one name per segment, however long it is; each name is
+    // measured the way the part will encode it
+    uint32_t size = 0;
+    const std::string * previous = 0;
+    NameList::const_iterator end = begin;
+    while (end != nameList.end ()) {
+      uint32_t nameSize = part->GetNameSize (previous, *end);
+      if (end != begin && size + nameSize > m_segmentSize) {
+        break;
+      }
+      size += nameSize;
+      previous = &*end;
+      end++;
+    }
+    NameList names (begin, end);
+    part->Swap (names);
+    parts.push_back (part);
+    begin = end;
+  } while (begin != nameList.end ());
+
+  segments.clear ();
+  for (uint32_t i = 0; i < parts.size (); i++) {
+    Ptr<Packet> packet = Create<Packet> ();
+    packet->AddHeader (*parts[i]);
+    packet->AddHeader (SegmentHeader (parts.size () - 1));
+
+    // the first segment answers the sync or IBF Interest; the others are pulled by name
+    Ptr<ndn::Name> name;
+    if (i > 0) {
+      name = MakeSegmentName (key, i);
+    } else if (key.ibf) {
+      name = Create<ndn::Name> (SYNC_IBF_PREFIX);
+      name->appendNumber (key.digest1);
+      name->appendNumber (key.digest2);
+    } else {
+      name = MakeSyncName (key.digest1, key.digest2);
+      name->appendNumber (0);
+    }
+    Ptr<ndn::Data> data = Create<ndn::Data> (packet);
+    data->SetName (name);
+    segments.push_back (data);
+  }
+}
+
+void
+SyncApp::SendSegment (const ReplyKey & key, uint32_t segment)
+{
+  HeldReplyMap::iterator held = m_heldReplies.find (key);
+  const Segments * segments = 0;
+  if (held != m_heldReplies.end ()) {
+    segments = &held->second.segments;
+  } else if (!key.ibf) {
+    segments = LookupReply (key.digest1, key.digest2);
+  }
+  Segments rebuilt;
+  if (segments == 0) {
+    // the reply was evicted from the cache (or built by another node), but
+    // it can be cut again identically as long as both digests are logged;
+    // an IBF reply depends on the filter of its requester and cannot
+    NameList nameList;
+    if (key.ibf || GetUpdateInbetween (key.digest1, key.digest2, nameList) == false) {
+      NS_LOG_DEBUG ("Cannot rebuild segmented reply: " << key.digest1 << " " << key.digest2);
+      return;
+    }
+    MakeSegments (key, nameList, rebuilt);
+    CacheReply (key.digest1, key.digest2, rebuilt);
+    segments = &rebuilt;
+  }
+  // the other segments of the fetch are served from here, even with the
+  // reply cache disabled, instead of cutting the whole reply again for each
+  segments = HoldReply (key, *segments);
+
+  if (segment >= segments->size ()) {
+    NS_LOG_DEBUG ("No segment " << segment << " in reply: " << key.digest1 << " " << key.digest2);
+    return;
+  }
+  NS_LOG_DEBUG ("Sending segment " << segment << ": " << key.digest1 << " " << key.digest2);
+  SendSyncData ((*segments)[segment]);
+}
+
+const SyncApp::Segments *
+SyncApp::HoldReply (const ReplyKey & key, const Segments & segments)
+{
+  std::pair<HeldReplyMap::iterator, bool> held = m_heldReplies.insert (std::make_pair (key, HeldReply ()));
+  if (held.second) {
+    held.first->second.segments = segments;
+  }
+  // a requester gives up after MAX_SEGMENT_RETRIES timeouts without progress
+  Simulator::Cancel (held.first->second.expiry);
+  held.first->second.expiry = Simulator::Schedule (Seconds (SEGMENT_INTEREST_LIFETIME * (MAX_SEGMENT_RETRIES + 1)),
+                                                   &SyncApp::OnHeldReplyExpiry, this, key);
+  return &held.first->second.segments;
+}
+
+void
+SyncApp::OnHeldReplyExpiry (ReplyKey key)
+{
+  NS_LOG_DEBUG ("Segmented reply no longer held: " << key.digest1 << " " << key.digest2);
+  m_heldReplies.erase (key);
+}
+
+void
+SyncApp::SendSegmentInterest (const ReplyKey & key, uint32_t segment)
+{
+  const Ptr<ndn::Interest> interest = BuildSyncInterest (key.digest1, key.digest2, Seconds (SEGMENT_INTEREST_LIFETIME));
+  interest->SetName (MakeSegmentName (key, segment));
+
+  NS_LOG_DEBUG ("Sending Segment Interest: " << key.digest1 << " " << key.digest2 << " " << segment);
+
+  Simulator::ScheduleNow (&ndn::Face::ReceiveInterest, m_face, interest);
+  m_transmittedInterests (interest, this, m_face);
+}
+
+void
+SyncApp::OnSegment (const ReplyKey & key, uint32_t segment, uint32_t finalSegment)
+{
+  ReassemblyMap::iterator i = m_reassembly.find (key);
+  if (i == m_reassembly.end ()) {
+    if (segment != 0) {
+      NS_LOG_DEBUG ("Segment " << segment << " of no pending reply: " << key.digest1 << " " << key.digest2);
+      return;
+    }
+    Reassembly & reassembly = m_reassembly[key];
+    reassembly.finalSegment = finalSegment;
+    reassembly.nextSegment = 1;
+    reassembly.received = 0;
+    reassembly.done.assign (finalSegment + 1, false);
+    reassembly.retries = 0;
+    i = m_reassembly.find (key);
+  }
+
+  Reassembly & reassembly = i->second;
+  if (finalSegment != reassembly.finalSegment || reassembly.done[segment]) {
+    return;
+  }
+  reassembly.done[segment] = true;
+  reassembly.received++;
+  reassembly.retries = 0;
+
+  const NameSpanList & names = m_rxNameList.GetNameList ();
+  for (NameSpanList::const_iterator name = names.begin (); name != names.end (); name++) {
+    reassembly.names.push_back (name->ToString ());
+  }
+
+  if (reassembly.received <= reassembly.finalSegment) {
+    RequestSegments (key, reassembly);
+    return;
+  }
+
+  // complete: the whole reply is still one digest step
+  NS_LOG_DEBUG ("Segmented reply complete: " << key.digest1 << " " << key.digest2);
+  Simulator::Cancel (reassembly.timeout);
+  NameList nameList;
+  nameList.swap (reassembly.names);
+  m_reassembly.erase (i);
+
+  if (Update (nameList)) {
+    ResetSyncInterval ();
+    OnNewUpdate ();
+  }
+}
+
+void
+SyncApp::RequestSegments (const ReplyKey & key, Reassembly & reassembly)
+{
+  // keep the pipeline full: one new Interest for every segment that arrived
+  while (reassembly.nextSegment <= reassembly.finalSegment &&
+         reassembly.nextSegment - std::min (reassembly.received, reassembly.nextSegment) < m_segmentPipeline) {
+    SendSegmentInterest (key, reassembly.nextSegment++);
+  }
+
+  Simulator::Cancel (reassembly.timeout);
+  reassembly.timeout = Simulator::Schedule (Seconds (SEGMENT_INTEREST_LIFETIME),
+                                            &SyncApp::OnSegmentTimeout, this, key);
+}
+
+void
+SyncApp::OnSegmentTimeout (ReplyKey key)
+{
+  ReassemblyMap::iterator i = m_reassembly.find (key);
+  if (i == m_reassembly.end ()) {
+    return;
+  }
+
+  Reassembly & reassembly = i->second;
+  if (++reassembly.retries > MAX_SEGMENT_RETRIES) {
+    NS_LOG_DEBUG ("Giving up segmented reply: " << key.digest1 << " " << key.digest2);
+    m_reassembly.erase (i);
+    ResetSyncInterval ();
+    return;
+  }
+
+  for (uint32_t segment = 1; segment < reassembly.nextSegment; segment++) {
+    if (!reassembly.done[segment]) {
+      SendSegmentInterest (key, segment);
+    }
+  }
+  reassembly.timeout = Simulator::Schedule (Seconds (SEGMENT_INTEREST_LIFETIME),
+                                            &SyncApp::OnSegmentTimeout, this, key);
+}
+
+void
+SyncApp::SetNameListEncoding (NameListHeader & nameList) const
+{
+  if (m_frontCodedNames) {
+    // sorted by MakeSegments, consecutive names of one router share all
+    // but their last components
+    nameList.SetEncoding (tlv::FRONT_CODED_ENCODING);
+  }
+}
+
+const SyncApp::Segments *
+SyncApp::LookupReply (uint64_t digest1, uint64_t digest2)
+{
+  boost::unordered_map<DigestPair, ReplyCache::iterator>::iterator i =
+    m_replyCacheIndex.find (DigestPair (digest1, digest2));
+  if (i == m_replyCacheIndex.end ()) {
+    return 0;
+  }
+  m_replyCache.splice (m_replyCache.begin (), m_replyCache, i->second);
+  return &i->second->second;
+}
+
+void
+SyncApp::CacheReply (uint64_t digest1, uint64_t digest2, const Segments & segments)
+{
+  if (m_replyCacheSize == 0) {
+    return;
+  }
+  if (m_replyCache.size () >= m_replyCacheSize) {
+    m_replyCacheIndex.erase (m_replyCache.back ().first);
+    m_replyCache.pop_back ();
+  }
+  DigestPair key (digest1, digest2);
+  m_replyCache.push_front (std::make_pair (key, segments));
+  m_replyCacheIndex[key] = m_replyCache.begin ();
+}
+
+void
+SyncApp::OnDigestEvicted (uint64_t digest)
+{
+  for (ReplyCache::iterator i = m_replyCache.begin (); i != m_replyCache.end (); ) {
+    if (i->first.first == digest || i->first.second == digest) {
+      m_replyCacheIndex.erase (i->first);
+      i = m_replyCache.erase (i);
+    } else {
+      i++;
+    }
+  }
+}
+
+void
+SyncApp::SetReplyCacheSize (uint32_t size)
+{
+  m_replyCacheSize = size;
+  while (m_replyCache.size () > m_replyCacheSize) {
+    m_replyCacheIndex.erase (m_replyCache.back ().first);
+    m_replyCache.pop_back ();
+  }
+}
+
+uint32_t
+SyncApp::GetReplyCacheSize () const
+{
+  return m_replyCacheSize;
+}
+
+void
+SyncApp::SendIbfInterest (uint64_t remoteDigest)
+{
+  Ptr<ndn::Name> name = Create<ndn::Name> (SYNC_IBF_PREFIX);
+  name->appendNumber (GetCurrentDigest ());
+  name->appendNumber (remoteDigest);
+
+  Ptr<Packet> payload = Create<Packet> ();
+  payload->AddHeader (GetIbf ());
+
+  Ptr<ndn::Interest> interest = Create<ndn::Interest> ();
+  UniformVariable rand (0,std::numeric_limits<uint32_t>::max ());
+  interest->SetNonce            (rand.GetValue ());
+  interest->SetName             (name);
+  interest->SetInterestLifetime (Seconds (SYNC_INTEREST_LIFETIME));
+  interest->SetScope            (2);
+  interest->SetPayload          (payload);
+
+  NS_LOG_DEBUG ("Sending IBF Interest: " << GetCurrentDigest () << " " << remoteDigest);
+
+  Simulator::ScheduleNow (&ndn::Face::ReceiveInterest, m_face, interest);
+  m_transmittedInterests (interest, this, m_face);
+}
+
+void
+SyncApp::OnIbfInterest (Ptr<const ndn::Interest> interest)
+{
+  if ( IsPacketDropped () ) { NS_LOG_DEBUG ("IBF Interest Packet Lost !"); return; }
+
+  Ptr<Packet> payload = interest->GetPayload ()->Copy ();
+  InvertibleBloomFilter remoteIbf;
+  payload->RemoveHeader (remoteIbf);
+  if (remoteIbf.GetCellCount () == 0) {
+    NS_LOG_DEBUG ("Malformed IBF Interest dropped");
+    return;
+  }
+
+  // a requester that asks again while pulling the segments of our reply gets
+  // the same reply, or the segments would not fit together
+  ReplyKey key;
+  if (GetIbfKeyFromName (interest->GetNamePtr (), key) == false) {
+    NS_LOG_DEBUG ("Malformed IBF Interest name dropped: " << interest->GetName ());
+    return;
+  }
+  HeldReplyMap::iterator held = m_heldReplies.find (key);
+  if (held != m_heldReplies.end ()) {
+    NS_LOG_DEBUG ("Sending held IBF reply: " << key.digest1 << " " << key.digest2);
+    SendSyncData (held->second.segments.front ());
+    return;
+  }
+
+  // only what the requester lacks; the other half of the difference it will
+  // learn when we run into its digest ourselves
+  NameList nameList;
+  if (GetUpdateByIbf (remoteIbf, nameList) == false) {
+    NS_LOG_DEBUG ("IBF not decodable, replying with the full state");
+    GetUpdateInbetween (INITIAL_DIGEST, GetCurrentDigest (), nameList);
+  }
+  if (nameList.empty ()) {
+    NS_LOG_DEBUG ("Nothing missing at the IBF requester");
+    return;
+  }
+
+  // the full state in particular is segmented like any other reply
+  Segments segments;
+  MakeSegments (key, nameList, segments);
+  NS_LOG_DEBUG ("Sending IBF reply: " << nameList.size () << " names in "
+                << segments.size () << " segments");
+  if (segments.size () > 1) {
+    HoldReply (key, segments);
+  }
+  SendSyncData (segments.front ());
+}
+
+bool
+SyncApp::IsIbfName (Ptr<const ndn::Name> name) const
+{
+  return name->size () > SYNC_IBF_PREFIX_SIZE &&
+         name->getPrefix (SYNC_IBF_PREFIX_SIZE).toUri ().compare (SYNC_IBF_PREFIX) == 0;
+}
+
+bool
+SyncApp::GetIbfKeyFromName (Ptr<const ndn::Name> name, ReplyKey & key) const
+{
+  // /ndn/sync/ibf/<requester digest>/<digest it asked about>
+  if (name->size () != SYNC_IBF_PREFIX_SIZE + 2) {
+    return false;
+  }
+  key = ReplyKey (name->get (SYNC_IBF_PREFIX_SIZE).toNumber (),
+                  name->get (SYNC_IBF_PREFIX_SIZE + 1).toNumber (), true);
+  return true;
 }
 
 /// ========================================
@@ -227,35 +881,368 @@ SyncApp::SendUpdateInbetween (uint64_t digest1, uint64_t digest2)
 void
 SyncApp::GenerateNewUpdate ()
 {
-  std::string s;
-  std::string old;
-
   std::stringstream out;
   out << GetNextSequenceNumber ();
 
-  IdSeqToName ("/" + GetRouterName () + "/unit-" + out.str(), 1, s);
-  Update (s, old);
-  NS_LOG_DEBUG ("New Updates: " << s << " New Digest: " << GetCurrentDigest ());
+  std::string id = "/" + GetRouterName () + "/unit-" + out.str();
+  Update (id, 1);
+  NS_LOG_DEBUG ("New Updates: " << id << " New Digest: " << GetCurrentDigest ());
 
   OnNewUpdate ();
   UniformVariable rand (1, 2);
   Simulator::Schedule (Seconds (rand.GetValue ()), &SyncApp::GenerateNewUpdate, this);
 }
 
+void
+SyncApp::OriginateLsu ()
+{
+  Ptr<LsuContent> lsu = Create<LsuContent> ();
+  lsu->SetLifetime (m_lsuLifetime);
+  BuildLsu (*lsu);
+
+  // seq#: time in ms, as the LSU naming asks for, but always past what
+  // sync holds for our key, which may come from an earlier incarnation
+  std::string key = GetLsuKey ();
+  m_lsuSeq = std::max<uint64_t> (std::max (m_lsuSeq, GetSeq (key)) + 1, Simulator::Now ().GetMilliSeconds ());
+
+  Simulator::Cancel (m_lsuRefreshEvent);
+  m_lsuRefreshEvent = Simulator::Schedule (Seconds (m_lsuLifetime / 2.0), &SyncApp::OriginateLsu, this);
+
+  if (Update (key, m_lsuSeq) == false) {
+    NS_LOG_DEBUG ("LSU not taken by sync: " << key << " " << m_lsuSeq);
+    return;
+  }
+
+  const Lsdb::Entry * current = m_lsdb->Find (key);
+  if (current != 0) {
+    m_previousLsu = current->content;
+    m_previousLsuSeq = current->seq;
+  }
+  m_lsdb->Install (key, m_lsuSeq, lsu);
+  NS_LOG_DEBUG ("Originated LSU: " << key << " " << m_lsuSeq);
+  OnNewUpdate ();
+}
+
+void
+SyncApp::BuildLsu (LsuContent & lsu) const
+{
+  for (std::map<std::string, Ptr<Face> >::const_iterator i = m_neighbors.begin (); i != m_neighbors.end (); i++) {
+    lsu.AddAdjacency (i->first, i->second->GetMetric ());
+  }
+  lsu.AddReachability ("/" + GetRouterName (), 0);
+}
+
+std::string
+SyncApp::MakeRouterName (Ptr<Node> node)
+{
+  std::stringstream ss;
+  ss << node->GetId ();
+  return "router-" + ss.str ();
+}
+
+void
+SyncApp::DiscoverNeighbors ()
+{
+  Ptr<Fib> fib = GetNode ()->GetObject<Fib> ();
+  Ptr<L3Protocol> ndn = GetNode ()->GetObject<L3Protocol> ();
+  for (uint32_t i = 0; i < ndn->GetNFaces (); i++) {
+    Ptr<NetDeviceFace> face = DynamicCast<NetDeviceFace> (ndn->GetFace (i));
+    if (face == 0) {
+      continue;  // an application face
+    }
+    Ptr<Channel> channel = face->GetNetDevice ()->GetChannel ();
+    if (channel == 0 || channel->GetNDevices () != 2) {
+      continue;  // only point-to-point links have one router at the other end
+    }
+    for (uint32_t d = 0; d < 2; d++) {
+      Ptr<Node> node = channel->GetDevice (d)->GetNode ();
+      if (node != GetNode ()) {
+        std::string neighbor = MakeRouterName (node);
+        NS_LOG_DEBUG ("Link to: " << neighbor << " face " << face->GetId ());
+        m_linkFaces[neighbor] = face;
+        fib->Add (ndn::Name (HELLO_PREFIX + "/" + neighbor), face, 0);
+        m_hello->AddNeighbor (neighbor);
+      }
+    }
+  }
+}
+
+void
+SyncApp::SendHelloInterest (Ptr<ndn::Name> name, Time lifetime)
+{
+  const Ptr<ndn::Interest> interest = BuildSyncInterest (0, 0, lifetime);
+  interest->SetName (name);
+
+  Simulator::ScheduleNow (&ndn::Face::ReceiveInterest, m_face, interest);
+  m_transmittedInterests (interest, this, m_face);
+}
+
+void
+SyncApp::OnAdjacencyChanged (const std::string & neighbor, bool up)
+{
+  if (up) {
+    m_neighbors[neighbor] = m_linkFaces[neighbor];
+    m_spf->SetNeighborFace (neighbor, m_linkFaces[neighbor]);
+  } else {
+    m_neighbors.erase (neighbor);
+    m_spf->RemoveNeighborFace (neighbor);
+  }
+  // one new LSU for all the adjacencies that change at once
+  Simulator::Cancel (m_lsuRefreshEvent);
+  m_lsuRefreshEvent = Simulator::ScheduleNow (&SyncApp::OriginateLsu, this);
+}
+
+uint64_t
+SyncApp::GetHelloDigest ()
+{
+  return GetCurrentDigest ();
+}
+
+void
+SyncApp::OnNeighborDigest (const std::string & neighbor, uint64_t digest)
+{
+  // a digest we went through is behind ours: the neighbor asks on our hello
+  if (digest == GetCurrentDigest () || IsDigestInLog (digest)) {
+    return;
+  }
+  NS_LOG_DEBUG ("Digest of " << neighbor << " differs: " << digest);
+  SendSyncInterest (GetCurrentDigest (), 0);
+}
+
+std::string
+SyncApp::GetLsuKey () const
+{
+  return NLSR_PREFIX + "/" + GetRouterName () + "/lsu";
+}
+
+bool
+SyncApp::IsLsuName (Ptr<const ndn::Name> name) const
+{
+  return name->size () > NLSR_PREFIX_SIZE &&
+         name->getPrefix (NLSR_PREFIX_SIZE).toUri ().compare (NLSR_PREFIX) == 0;
+}
+
+bool
+SyncApp::GetLsuFromName (Ptr<const ndn::Name> name, std::string & key, uint64_t & seq, uint64_t & baseSeq) const
+{
+  // /nlsr/<router>/<lsu>/<seq#>[/<base seq#>]
+  if (name->size () != NLSR_PREFIX_SIZE + 3 && name->size () != NLSR_PREFIX_SIZE + 4) {
+    return false;
+  }
+  baseSeq = name->size () == NLSR_PREFIX_SIZE + 4 ? name->get (NLSR_PREFIX_SIZE + 3).toNumber () : 0;
+  return Lsdb::ParseLsuName (name->getPrefix (NLSR_PREFIX_SIZE + 3).toUri (), key, seq);
+}
+
+void
+SyncApp::OnLsuInterest (Ptr<const ndn::Interest> interest)
+{
+  std::string key;
+  uint64_t seq, baseSeq;
+  if (GetLsuFromName (interest->GetNamePtr (), key, seq, baseSeq) == false) {
+    NS_LOG_DEBUG ("Malformed LSU Interest: " << interest->GetName ());
+    return;
+  }
+  const Lsdb::Entry * entry = m_lsdb->Find (key);
+  if (entry == 0 || entry->seq != seq) {
+    NS_LOG_DEBUG ("No LSU to answer: " << key << " " << seq);
+    return;
+  }
+
+  // only the originator keeps the version before, to send the delta from it
+  Ptr<const LsuContent> content = entry->content;
+  if (baseSeq != 0 && key == GetLsuKey () && baseSeq == m_previousLsuSeq && m_previousLsu != 0) {
+    content = LsuContent::MakeDelta (*m_previousLsu, baseSeq, *entry->content);
+  }
+  NS_LOG_DEBUG ("Sending LSU: " << key << " " << seq << (content->IsDelta () ? " delta" : ""));
+
+  Ptr<Packet> packet = Create<Packet> ();
+  packet->AddHeader (*content);
+  Ptr<ndn::Data> data = Create<ndn::Data> (packet);
+  data->SetName (Create<ndn::Name> (interest->GetName ()));
+  SendSyncData (data);
+}
+
+void
+SyncApp::OnLsuData (Ptr<const ndn::Data> data)
+{
+  std::string key;
+  uint64_t seq, baseSeq;
+  if (GetLsuFromName (data->GetNamePtr (), key, seq, baseSeq) == false) {
+    NS_LOG_DEBUG ("Malformed LSU name: " << data->GetName ());
+    return;
+  }
+  LsuFetchMap::iterator fetch = m_lsuFetches.find (key);
+  if (fetch == m_lsuFetches.end () || fetch->second.seq != seq) {
+    NS_LOG_DEBUG ("LSU not asked for: " << key << " " << seq);
+    return;
+  }
+
+  // parsed from a flat copy, like the sync replies, so a malformed LSU is
+  // dropped instead of read past its end
+  Ptr<const Packet> payload = data->GetPayload ();
+  m_rxBuffer.resize (std::max<uint32_t> (payload->GetSize (), 1));
+  uint32_t size = payload->CopyData (&m_rxBuffer[0], payload->GetSize ());
+  if (m_rxLsu.Parse (&m_rxBuffer[0], size) == false) {
+    NS_LOG_DEBUG ("Malformed LSU: " << key << " " << seq);
+    return;
+  }
+  Ptr<LsuContent> content = LsuContent::FromView (m_rxLsu);
+
+  if (content->IsDelta ()) {
+    if (m_lsdb->InstallDelta (key, seq, *content) == false) {
+      NS_LOG_DEBUG ("Delta does not apply, fetching full LSU: " << key << " " << seq);
+      fetch->second.retries = 0;
+      SendLsuInterest (key, seq, 0);
+      return;
+    }
+  } else {
+    m_lsdb->Install (key, seq, content);
+  }
+  NS_LOG_DEBUG ("Received LSU: " << key << " " << seq);
+  Simulator::Cancel (fetch->second.timeout);
+  m_lsuFetches.erase (fetch);
+}
+
+void
+SyncApp::SendLsuInterest (const std::string & key, uint64_t seq, uint64_t baseSeq)
+{
+  Ptr<ndn::Name> name = Create<ndn::Name> (key);
+  name->appendNumber (seq);
+  if (baseSeq != 0) {
+    name->appendNumber (baseSeq);
+  }
+  const Ptr<ndn::Interest> interest = BuildSyncInterest (0, 0, Seconds (LSU_INTEREST_LIFETIME));
+  interest->SetName (name);
+
+  NS_LOG_DEBUG ("Sending LSU Interest: " << key << " " << seq << " base " << baseSeq);
+  Simulator::ScheduleNow (&ndn::Face::ReceiveInterest, m_face, interest);
+  m_transmittedInterests (interest, this, m_face);
+
+  LsuFetch & fetch = m_lsuFetches[key];
+  Simulator::Cancel (fetch.timeout);
+  fetch.timeout = Simulator::Schedule (Seconds (LSU_INTEREST_LIFETIME), &SyncApp::OnLsuTimeout, this, key);
+}
+
+void
+SyncApp::OnNameUpdated (const std::string & id, uint64_t seq)
+{
+  if (id.compare (0, NLSR_PREFIX.size (), NLSR_PREFIX) == 0 && id != GetLsuKey ()) {
+    m_announcedLsus.push_back (std::make_pair (id, seq));
+  }
+}
+
+bool
+SyncApp::IsExpiringId (const std::string & id) const
+{
+  return id.compare (0, NLSR_PREFIX.size (), NLSR_PREFIX) != 0;
+}
+
+void
+SyncApp::FetchLsus ()
+{
+  for (std::vector<std::pair<std::string, uint64_t> >::const_iterator i = m_announcedLsus.begin ();
+       i != m_announcedLsus.end ();
+       i++)
+  {
+    const std::string & key = i->first;
+    uint64_t seq = i->second;
+    LsuFetchMap::iterator fetch = m_lsuFetches.find (key);
+    if (m_lsdb->GetSeq (key) >= seq || (fetch != m_lsuFetches.end () && fetch->second.seq >= seq)) {
+      continue;
+    }
+
+    LsuFetch & newFetch = m_lsuFetches[key];
+    newFetch.seq = seq;
+    newFetch.retries = 0;
+    SendLsuInterest (key, seq, m_lsdb->GetSeq (key));
+  }
+  m_announcedLsus.clear ();
+}
+
+void
+SyncApp::OnLsuTimeout (std::string key)
+{
+  LsuFetchMap::iterator fetch = m_lsuFetches.find (key);
+  if (fetch == m_lsuFetches.end ()) {
+    return;
+  }
+  if (++fetch->second.retries > MAX_LSU_RETRIES) {
+    // a newer version announced by sync starts over
+    NS_LOG_DEBUG ("Giving up LSU: " << key << " " << fetch->second.seq);
+    m_lsuFetches.erase (fetch);
+    return;
+  }
+  // the retry asks for the full LSU, which any holder can answer
+  SendLsuInterest (key, fetch->second.seq, 0);
+}
+
 void
 SyncApp::OnNewUpdate ()
 {
-  if (GetOutstandingDigest () == 0) {
+  ScheduleExpiry ();
+  FetchLsus ();
+
+  if (m_coalescingWindow.IsZero ()) {
+    FlushUpdates ();
+    return;
+  }
+
+  if (m_flushEvent.IsRunning ()) {
+    Simulator::Cancel (m_flushEvent);
+    m_suppressedInterests++;
+  } else {
+    m_firstPendingUpdate = Simulator::Now ();
+  }
+
+  // extend the window, up to the max delay from the first held-back update
+  Time flushAt = Min (Simulator::Now () + m_coalescingWindow,
+                      m_firstPendingUpdate + m_coalescingMaxDelay);
+  m_flushEvent = Simulator::Schedule (flushAt - Simulator::Now (), &SyncApp::FlushUpdates, this);
+}
+
+void
+SyncApp::FlushUpdates ()
+{
+  std::vector<uint64_t> digests;
+  GetOutstandingDigests (digests);
+  if (digests.empty ()) {
     NS_LOG_DEBUG ("No Outstanding Interest");
   } else {
-    SendUpdateInbetween (GetOutstandingDigest (), GetCurrentDigest ());
-    SetOutstandingDigest (0);
+    // every neighbour parked on an older digest gets its diff; the Interests
+    // are consumed by the replies
+    SendUpdatesInbetween (digests, GetCurrentDigest ());
+    m_outstandingDigests.clear ();
   }
   SendSyncInterest (GetCurrentDigest(), 0);
 }
 
+void
+SyncApp::OnIdExpiry ()
+{
+  uint32_t expired = ExpireIds ();
+  NS_LOG_DEBUG ("Expired ids: " << expired << " Ids left: " << GetIdCount ()
+                << " New Digest: " << GetCurrentDigest ());
+  if (expired > 0) {
+    OnNewUpdate ();
+  } else {
+    ScheduleExpiry ();
+  }
+}
+
+void
+SyncApp::ScheduleExpiry ()
+{
+  // ids only ever become due later than the oldest one
+  Time when;
+  if (m_expiryEvent.IsRunning () || GetNextExpiry (when) == false) {
+    return;
+  }
+  m_expiryEvent = Simulator::Schedule (Max (when - Simulator::Now (), Seconds (0)),
+                                       &SyncApp::OnIdExpiry, this);
+}
+
 const Ptr<ndn::Interest>
-SyncApp::BuildSyncInterest (uint64_t digest1, uint64_t digest2)
+SyncApp::BuildSyncInterest (uint64_t digest1, uint64_t digest2, Time lifetime)
 {
   Ptr<ndn::Name> name = Create<ndn::Name> (SYNC_PREFIX);
   name->appendNumber (digest1);
@@ -266,23 +1253,35 @@ SyncApp::BuildSyncInterest (uint64_t digest1, uint64_t digest2)
   UniformVariable rand (0,std::numeric_limits<uint32_t>::max ());
   interest->SetNonce            (rand.GetValue ());
   interest->SetName             (name);
-  interest->SetInterestLifetime (Seconds (5.0));
+  interest->SetInterestLifetime (lifetime);
   interest->SetScope            (2);  
 
   return interest;
 }
 
 void
-SyncApp::SetOutstandingDigest (uint64_t digest)
+SyncApp::AddOutstandingDigest (uint64_t digest, Time lifetime)
 {
-  m_outstandingDigest = digest;
+  // a refreshed Interest for the same digest just extends the entry
+  Time & expiry = m_outstandingDigests[digest];
+  expiry = Max (expiry, Simulator::Now () + lifetime);
   IncreaseCounter (digest);
 }
 
-uint64_t
-SyncApp::GetOutstandingDigest () const
+void
+SyncApp::GetOutstandingDigests (std::vector<uint64_t> & digests)
 {
-  return m_outstandingDigest;
+  Time now = Simulator::Now ();
+  for (std::map<uint64_t, Time>::iterator i = m_outstandingDigests.begin ();
+       i != m_outstandingDigests.end (); ) {
+    if (i->second <= now) {
+      NS_LOG_DEBUG ("Outstanding Interest expired: " << i->first);
+      m_outstandingDigests.erase (i++);
+    } else {
+      digests.push_back (i->first);
+      i++;
+    }
+  }
 }
 
 uint64_t
@@ -318,7 +1317,7 @@ SyncApp::GetDigestFromName (Ptr<const ndn::Name> name, uint64_t & digest1, uint6
   NS_ASSERT (name->getPrefix (SYNC_PREFIX_SIZE).toUri ().compare (SYNC_PREFIX) == 0);
 
   digest1 = name->get (SYNC_PREFIX_SIZE).toNumber ();  
-  if (name->size () == SYNC_PREFIX_SIZE + 2) {
+  if (name->size () >= SYNC_PREFIX_SIZE + 2) {
     digest2 = name->get (SYNC_PREFIX_SIZE + 1).toNumber ();
   } else {
     digest2 = 0;
@@ -326,6 +1325,42 @@ SyncApp::GetDigestFromName (Ptr<const ndn::Name> name, uint64_t & digest1, uint6
   return digest1;
 }
 
+Ptr<ndn::Name>
+SyncApp::MakeSegmentName (const ReplyKey & key, uint32_t segment) const
+{
+  Ptr<ndn::Name> name = Create<ndn::Name> (SYNC_SEGMENT_PREFIX);
+  if (key.ibf) {
+    name->append (SYNC_IBF_SEGMENT_COMPONENT);
+  }
+  name->appendNumber (key.digest1);
+  name->appendNumber (key.digest2);
+  name->appendNumber (segment);
+  return name;
+}
+
+bool
+SyncApp::GetSegmentFromName (Ptr<const ndn::Name> name, ReplyKey & key, uint32_t & segment) const
+{
+  // /ndn/sync/seg[/ibf]/<digest1>/<digest2>/<segment>
+  if (name->size () < SYNC_SEGMENT_PREFIX_SIZE + 3 ||
+      name->getPrefix (SYNC_SEGMENT_PREFIX_SIZE).toUri ().compare (SYNC_SEGMENT_PREFIX) != 0) {
+    return false;
+  }
+  size_t i = SYNC_SEGMENT_PREFIX_SIZE;
+  key.ibf = name->size () == SYNC_SEGMENT_PREFIX_SIZE + 4;
+  if (key.ibf) {
+    if (name->get (i++).toUri () != SYNC_IBF_SEGMENT_COMPONENT) {
+      return false;
+    }
+  } else if (name->size () != SYNC_SEGMENT_PREFIX_SIZE + 3) {
+    return false;
+  }
+  key.digest1 = name->get (i).toNumber ();
+  key.digest2 = name->get (i + 1).toNumber ();
+  segment = name->get (i + 2).toNumber ();
+  return true;
+}
+
 const std::string &
 SyncApp::GetRouterName () const
 {
@@ -338,16 +1373,80 @@ SyncApp::SetRouterName (const std::string & routerName)
   m_routerName = routerName;
 }
 
-uint64_t
-SyncApp::GetUnknownDigest () const
+void
+SyncApp::AddUnknownDigest (uint64_t digest)
 {
-  return m_unknownDigest;
+  m_unknownDigests[digest] = Simulator::Now () + Seconds (SYNC_INTEREST_LIFETIME);
+}
+
+bool
+SyncApp::IsUnknownDigest (uint64_t digest)
+{
+  Time now = Simulator::Now ();
+  for (std::map<uint64_t, Time>::iterator i = m_unknownDigests.begin ();
+       i != m_unknownDigests.end (); ) {
+    if (i->second <= now) {
+      m_unknownDigests.erase (i++);
+    } else {
+      i++;
+    }
+  }
+  return m_unknownDigests.find (digest) != m_unknownDigests.end ();
+}
+
+uint32_t
+SyncApp::GetDigestLogLength () const
+{
+  return GetMaxLogLength ();
+}
+
+void
+SyncApp::SetDigestLogLength (uint32_t length)
+{
+  SetMaxLogLength (length);
+
+  // a shrinking log drops digests without OnDigestEvicted
+  m_replyCache.clear ();
+  m_replyCacheIndex.clear ();
+}
+
+uint32_t
+SyncApp::GetIbfSize () const
+{
+  return GetIbfCells ();
+}
+
+void
+SyncApp::SetIbfSize (uint32_t cells)
+{
+  SetIbfCells (cells);
+}
+
+uint32_t
+SyncApp::GetDigestLogChanges () const
+{
+  return GetMaxLogChanges ();
 }
 
 void
-SyncApp::SetUnknownDigest (uint64_t digest)
+SyncApp::SetDigestLogChanges (uint32_t changes)
 {
-  m_unknownDigest = digest;
+  SetMaxLogChanges (changes);
+}
+
+Time
+SyncApp::GetNameLifetime () const
+{
+  return GetIdLifetime ();
+}
+
+void
+SyncApp::SetNameLifetime (Time lifetime)
+{
+  SetIdLifetime (lifetime);
+
+  Simulator::Cancel (m_expiryEvent);
+  ScheduleExpiry ();
 }
 
 } // namespace ndn
@@ -23,9 +23,19 @@
 #ifndef SYNC_APP_H_
 #define SYNC_APP_H_
 
+#include "nlsr-hello.h"
+#include "nlsr-lsdb.h"
 #include "nlsr-lsu.h"
+#include "nlsr-spf.h"
 #include "sync-state.h"
 #include "ns3/ndn-app.h"
+#include "ns3/nstime.h"
+#include "ns3/event-id.h"
+#include "ns3/traced-value.h"
+
+#include <boost/unordered_map.hpp>
+#include <list>
+#include <map>
 
 namespace ns3 {
 namespace ndn {
@@ -43,7 +53,23 @@ namespace ndn {
 
 static const std::string SYNC_PREFIX = "/ndn/sync";
 static const uint16_t SYNC_PREFIX_SIZE = 2;
+static const std::string SYNC_IBF_PREFIX = "/ndn/sync/ibf";  // /ndn/sync/ibf/<our digest>/<unknown digest>
+static const uint16_t SYNC_IBF_PREFIX_SIZE = 3;
+static const std::string SYNC_SEGMENT_PREFIX = "/ndn/sync/seg";  // /ndn/sync/seg[/ibf]/<digest1>/<digest2>/<segment>
+static const std::string SYNC_IBF_SEGMENT_COMPONENT = "ibf";  // in the names of segments of IBF replies
+static const uint16_t SYNC_SEGMENT_PREFIX_SIZE = 3;
 static const double PACKET_LOSS_RATE = 0.1;
+static const double SYNC_INTEREST_LIFETIME = 5.0; // seconds
+static const uint32_t DEFAULT_REPLY_CACHE_SIZE = 64;
+static const double BACKOFF_FACTOR = 2.0;  // growth of the periodic sync interval while synced
+static const uint32_t DEFAULT_SEGMENT_SIZE = 1024;  // bytes of names per sync reply segment
+static const uint32_t DEFAULT_SEGMENT_PIPELINE = 4;
+static const double SEGMENT_INTEREST_LIFETIME = 1.0; // seconds
+static const uint32_t MAX_SEGMENT_RETRIES = 3;
+static const uint16_t NLSR_PREFIX_SIZE = 1;
+static const uint32_t DEFAULT_LSU_LIFETIME = 86400;  // seconds, refreshed at half of it
+static const double LSU_INTEREST_LIFETIME = 1.0; // seconds
+static const uint32_t MAX_LSU_RETRIES = 3;
 
 class SyncApp : public ndn::App, SyncState
 {
@@ -71,10 +97,80 @@ public:
   virtual void
   OnData (Ptr<const ndn::Data> data);
 
+protected:
+  // (overridden from SyncState) Drop cached replies that end at an evicted digest
+  virtual void
+  OnDigestEvicted (uint64_t digest);
+
+  // (overridden from SyncState) Note the LSUs to fetch
+  virtual void
+  OnNameUpdated (const std::string & id, uint64_t seq);
+
+  // (overridden from SyncState) LSU keys are aged by the LSDB, not by sync
+  virtual bool
+  IsExpiringId (const std::string & id) const;
+
 private:
+  typedef std::pair<uint64_t, uint64_t> DigestPair;
+  typedef std::vector<Ptr<ndn::Data> > Segments;
+  typedef std::list<std::pair<DigestPair, Segments> > ReplyCache;  // most recently used first
+
+  // a segmented reply, by the Interest it answers: a sync Interest for
+  // (digest1, digest2), or the IBF Interest of those digests
+  struct ReplyKey
+  {
+    uint64_t digest1;
+    uint64_t digest2;
+    bool ibf;
+
+    ReplyKey (uint64_t d1 = 0, uint64_t d2 = 0, bool i = false)
+    : digest1 (d1), digest2 (d2), ibf (i)
+    {}
+
+    bool
+    operator< (const ReplyKey & other) const
+    {
+      if (digest1 != other.digest1) return digest1 < other.digest1;
+      if (digest2 != other.digest2) return digest2 < other.digest2;
+      return ibf < other.ibf;
+    }
+  };
+
+  // a segmented reply being fetched; segment 0 has arrived
+  struct Reassembly
+  {
+    uint32_t finalSegment;
+    uint32_t nextSegment;  // lowest segment not requested yet
+    uint32_t received;
+    std::vector<bool> done;
+    NameList names;
+    uint32_t retries;
+    EventId timeout;
+  };
+  typedef std::map<ReplyKey, Reassembly> ReassemblyMap;
+
+  // a segmented reply kept while its segments are being pulled from us,
+  // whether the reply cache keeps it or not
+  struct HeldReply
+  {
+    Segments segments;
+    EventId expiry;
+  };
+  typedef std::map<ReplyKey, HeldReply> HeldReplyMap;
+
+  // an LSU being fetched, by key /nlsr/<router>/<lsu>
+  struct LsuFetch
+  {
+    uint64_t seq;
+    uint32_t retries;
+    EventId timeout;
+  };
+  typedef std::map<std::string, LsuFetch> LsuFetchMap;
+
 
   void
-  SendSyncInterest (uint64_t oldDigest, uint64_t newDigest);
+  SendSyncInterest (uint64_t oldDigest, uint64_t newDigest,
+                    Time lifetime = Seconds (SYNC_INTEREST_LIFETIME));
 
   void
   SendSyncData (Ptr<ndn::Data> data);
@@ -82,29 +178,170 @@ private:
   void
   SendUpdateInbetween (uint64_t digest1, uint64_t digest2);
 
+  void
+  SendUpdatesInbetween (const std::vector<uint64_t> & digests, uint64_t digest2);
+
+  /// Segments, caches and sends the reply; nameList is sorted on the way
+  void
+  SendNameList (uint64_t digest1, uint64_t digest2, NameList & nameList);
+
+  void
+  MakeSegments (const ReplyKey & key, NameList & nameList, Segments & segments) const;
+
+  void
+  SendSegment (const ReplyKey & key, uint32_t segment);
+
+  /// Keep segments until none of them has been asked for in a while
+  const Segments *
+  HoldReply (const ReplyKey & key, const Segments & segments);
+
+  void
+  OnHeldReplyExpiry (ReplyKey key);
+
+  void
+  SendSegmentInterest (const ReplyKey & key, uint32_t segment);
+
+  void
+  OnSegment (const ReplyKey & key, uint32_t segment, uint32_t finalSegment);
+
+  void
+  RequestSegments (const ReplyKey & key, Reassembly & reassembly);
+
+  void
+  OnSegmentTimeout (ReplyKey key);
+
+  void
+  SetNameListEncoding (NameListHeader & nameList) const;
+
   void
   PeriodicalSyncInterest ();
 
+  void
+  ScheduleSyncInterest ();
+
+  void
+  ResetSyncInterval ();
+
+  void
+  SendIbfInterest (uint64_t remoteDigest);
+
+  void
+  OnIbfInterest (Ptr<const ndn::Interest> interest);
+
+  bool
+  IsIbfName (Ptr<const ndn::Name> name) const;
+
+  /// The key of the reply to the IBF Interest of that name; false if malformed
+  bool
+  GetIbfKeyFromName (Ptr<const ndn::Name> name, ReplyKey & key) const;
+
   const Ptr<ndn::Interest>
-  BuildSyncInterest (uint64_t digest1, uint64_t digest2);
+  BuildSyncInterest (uint64_t digest1, uint64_t digest2, Time lifetime);
+
+  const Segments *
+  LookupReply (uint64_t digest1, uint64_t digest2);
+
+  void
+  CacheReply (uint64_t digest1, uint64_t digest2, const Segments & segments);
+
+  void
+  SetReplyCacheSize (uint32_t size);
+
+  uint32_t
+  GetReplyCacheSize () const;
 
   Ptr<ndn::Name> 
   MakeSyncName (uint64_t oldDigest, uint64_t newDigest) const;
 
+  /// Name of a segment after the first, under a prefix of its own so that it
+  /// matches none of the sync Interests parked at other routers
+  Ptr<ndn::Name>
+  MakeSegmentName (const ReplyKey & key, uint32_t segment) const;
+
   uint64_t
   GetDigestFromName (Ptr<const ndn::Name> name, uint64_t & digest1, uint64_t & digest2) const;
 
+  /// @returns false if name is not that of a segment after the first
+  bool
+  GetSegmentFromName (Ptr<const ndn::Name> name, ReplyKey & key, uint32_t & segment) const;
+
   void
   GenerateNewUpdate ();
 
+  /// Publish a new version of our LSU and schedule its refresh
   void
-  OnNewUpdate ();
+  OriginateLsu ();
 
   void
-  SetOutstandingDigest (uint64_t digest);
+  BuildLsu (LsuContent & lsu) const;
+
+  /// Name of the router on node, the same for every SyncApp there
+  static std::string
+  MakeRouterName (Ptr<Node> node);
 
+  /// Find the routers at the other end of our point-to-point links, and
+  /// start saying hello to them
+  void
+  DiscoverNeighbors ();
+
+  void
+  SendHelloInterest (Ptr<ndn::Name> name, Time lifetime);
+
+  /// A neighbor came up or went down: route through it or not, and say so in our LSU
+  void
+  OnAdjacencyChanged (const std::string & neighbor, bool up);
+
+  /// What the hellos say our sync digest is
   uint64_t
-  GetOutstandingDigest () const;
+  GetHelloDigest ();
+
+  /// A hello told the digest of a neighbor: ask for what it has that we have not
+  void
+  OnNeighborDigest (const std::string & neighbor, uint64_t digest);
+
+  std::string
+  GetLsuKey () const;
+
+  bool
+  IsLsuName (Ptr<const ndn::Name> name) const;
+
+  bool
+  GetLsuFromName (Ptr<const ndn::Name> name, std::string & key, uint64_t & seq, uint64_t & baseSeq) const;
+
+  void
+  OnLsuInterest (Ptr<const ndn::Interest> interest);
+
+  void
+  OnLsuData (Ptr<const ndn::Data> data);
+
+  /// Ask for version seq of the LSU key, as a delta if baseSeq is not 0
+  void
+  SendLsuInterest (const std::string & key, uint64_t seq, uint64_t baseSeq);
+
+  void
+  FetchLsus ();
+
+  void
+  OnLsuTimeout (std::string key);
+
+  void
+  OnNewUpdate ();
+
+  void
+  FlushUpdates ();
+
+  /// Tombstone or drop the ids due, see SyncState::ExpireIds
+  void
+  OnIdExpiry ();
+
+  void
+  ScheduleExpiry ();
+
+  void
+  AddOutstandingDigest (uint64_t digest, Time lifetime);
+
+  void
+  GetOutstandingDigests (std::vector<uint64_t> & digests);
 
   const std::string &
   GetRouterName () const;
@@ -119,16 +356,105 @@ private:
   IsPacketDropped () const;
 
   void
-  SetUnknownDigest (uint64_t digest);
+  AddUnknownDigest (uint64_t digest);
 
-  uint64_t
-  GetUnknownDigest () const;
+  bool
+  IsUnknownDigest (uint64_t digest);
+
+  uint32_t
+  GetDigestLogLength () const;
+
+  void
+  SetDigestLogLength (uint32_t length);
+
+  uint32_t
+  GetIbfSize () const;
+
+  void
+  SetIbfSize (uint32_t cells);
+
+  uint32_t
+  GetDigestLogChanges () const;
+
+  void
+  SetDigestLogChanges (uint32_t changes);
+
+  Time
+  GetNameLifetime () const;
+
+  void
+  SetNameLifetime (Time lifetime);
 
 private:
   std::string m_routerName;
   uint64_t m_seq;
-  uint64_t m_outstandingDigest;
-  uint64_t m_unknownDigest;
+  std::map<uint64_t, Time> m_outstandingDigests;  // digests of sync Interests we sit on -> expiry
+  std::map<uint64_t, Time> m_unknownDigests;      // unknown digests already asked about -> expiry
+
+  // receive buffer of OnData and the views over it, kept to reuse their storage
+  std::vector<uint8_t> m_rxBuffer;
+  NameListView m_rxNameList;
+  LsuContentView m_rxLsu;
+  bool m_ibfReconciliation;
+  bool m_frontCodedNames;
+
+  // ready-to-send replies of SendUpdateInbetween, keyed by (digest1, digest2)
+  ReplyCache m_replyCache;
+  boost::unordered_map<DigestPair, ReplyCache::iterator> m_replyCacheIndex;
+  uint32_t m_replyCacheSize;
+
+  // replies are cut into segments of at most m_segmentSize bytes of names;
+  // up to m_segmentPipeline segment Interests are in flight per reply
+  uint32_t m_segmentSize;
+  uint32_t m_segmentPipeline;
+  ReassemblyMap m_reassembly;
+  HeldReplyMap m_heldReplies;
+
+  // updates arriving within m_coalescingWindow of each other are advertised
+  // once, but never later than m_coalescingMaxDelay after the first of them
+  Time m_coalescingWindow;
+  Time m_coalescingMaxDelay;
+  Time m_firstPendingUpdate;
+  EventId m_flushEvent;
+  TracedValue<uint32_t> m_suppressedInterests;
+
+  // the periodic sync Interest backs off from m_syncIntervalMin to
+  // m_syncIntervalMax while we stay synced, and is randomized by
+  // +/- m_syncIntervalJitter of the interval
+  Time m_syncIntervalMin;
+  Time m_syncIntervalMax;
+  double m_syncIntervalJitter;
+  Time m_syncInterval;
+  bool m_syncChanged;  // new names or a divergence since the last periodic Interest
+  EventId m_syncEvent;
+
+  // the hellos carry our digest and bring those of the neighbors, in place
+  // of the periodic sync Interest
+  bool m_digestInHello;
+
+  // runs ExpireIds when the oldest id in the state is due
+  EventId m_expiryEvent;
+
+  // the node's LSDB; our own LSU is kept there too, with its previous
+  // version to answer delta requests
+  Ptr<Lsdb> m_lsdb;
+  Ptr<Spf> m_spf;
+  Ptr<HelloProtocol> m_hello;
+  Time m_helloInterval;
+  uint32_t m_deadTime;
+  std::map<std::string, Ptr<Face> > m_linkFaces;  // router -> face of our link to it
+  std::map<std::string, Ptr<Face> > m_neighbors;  // the routers m_hello has up: our adjacencies
+  uint32_t m_maxNextHops;  // given to the node's Spf when we create it
+  uint32_t m_lsuLifetime;
+  uint64_t m_lsuSeq;
+  Ptr<const LsuContent> m_previousLsu;
+  uint64_t m_previousLsuSeq;
+  EventId m_lsuRefreshEvent;
+
+  // LSU versions sync announced during the current update, and the fetches
+  // they started
+  std::vector<std::pair<std::string, uint64_t> > m_announcedLsus;
+  LsuFetchMap m_lsuFetches;
 
 };
 
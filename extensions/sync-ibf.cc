@@ -0,0 +1,266 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// sync-ibf.cc
+
+#include "sync-ibf.h"
+#include "ns3/assert.h"
+#include "ns3/log.h"
+
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE ("SyncIbf");
+
+namespace ns3 {
+namespace ndn {
+
+// ========== Class InvertibleBloomFilter ============
+
+NS_OBJECT_ENSURE_REGISTERED (InvertibleBloomFilter);
+
+const uint32_t InvertibleBloomFilter::HASH_COUNT;
+
+namespace {
+
+uint64_t
+Mix (uint64_t h)
+{
+  h = (h ^ (h >> 33)) * 0xFF51AFD7ED558CCDULL;
+  h = (h ^ (h >> 33)) * 0xC4CEB9FE1A85EC53ULL;
+  return h ^ (h >> 33);
+}
+
+} // anonymous namespace
+
+InvertibleBloomFilter::InvertibleBloomFilter (uint32_t cells)
+{
+  Reset (cells);
+}
+
+InvertibleBloomFilter::~InvertibleBloomFilter ()
+{
+}
+
+TypeId
+InvertibleBloomFilter::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("InvertibleBloomFilter")
+    .SetParent<Header> ()
+    .AddConstructor<InvertibleBloomFilter> ()
+  ;
+  return tid;
+}
+
+TypeId
+InvertibleBloomFilter::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+InvertibleBloomFilter::GetSerializedSize (void) const
+{
+  uint32_t size = sizeof (uint32_t) +
+                  m_cells.size () * (sizeof (uint32_t) + 2 * sizeof (uint64_t));
+
+  NS_LOG_DEBUG ("GetSerializedSize InvertibleBloomFilter: " << size);
+  return size;
+}
+
+void
+InvertibleBloomFilter::Print (std::ostream &os) const
+{
+  os << "=== InvertibleBloomFilter ===" << std::endl;
+  os << "Cells:  " << m_cells.size () << std::endl;
+  for (uint32_t i = 0; i < m_cells.size (); i++) {
+    if (m_cells[i].count != 0) {
+      os << "Cell " << i << ":  Count:  " << m_cells[i].count
+         << "  KeySum:  " << m_cells[i].keySum << std::endl;
+    }
+  }
+}
+
+void
+InvertibleBloomFilter::Serialize (Buffer::Iterator start) const
+{
+  Buffer::Iterator i = start;
+  i.WriteHtonU32 (GetSerializedSize () - sizeof (uint32_t));
+
+  for (std::vector<Cell>::const_iterator cell = m_cells.begin ();
+       cell != m_cells.end ();
+       cell++) {
+    i.WriteHtonU32 (static_cast<uint32_t> (cell->count));
+    i.WriteHtonU64 (cell->keySum);
+    i.WriteHtonU64 (cell->hashSum);
+  }
+}
+
+uint32_t
+InvertibleBloomFilter::Deserialize (Buffer::Iterator start)
+{
+  // the payload of a remote Interest: its length word is checked against
+  // what is really there, and a bad one leaves the filter without cells
+  m_cells.clear ();
+  if (start.GetRemainingSize () < sizeof (uint32_t)) {
+    NS_LOG_DEBUG ("Truncated IBF");
+    return 0;
+  }
+  uint32_t messageSize = start.ReadNtohU32 ();
+  Buffer::Iterator i = start;
+
+  uint32_t cellSize = sizeof (uint32_t) + 2 * sizeof (uint64_t);
+  if (messageSize % cellSize != 0 || messageSize > i.GetRemainingSize ()) {
+    NS_LOG_DEBUG ("Malformed IBF of " << messageSize << " bytes");
+    return sizeof (messageSize);
+  }
+
+  m_cells.resize (messageSize / cellSize);
+  for (std::vector<Cell>::iterator cell = m_cells.begin ();
+       cell != m_cells.end ();
+       cell++) {
+    cell->count = static_cast<int32_t> (i.ReadNtohU32 ());
+    cell->keySum = i.ReadNtohU64 ();
+    cell->hashSum = i.ReadNtohU64 ();
+  }
+
+  return messageSize + sizeof (messageSize);
+}
+
+uint32_t
+InvertibleBloomFilter::GetCellCount () const
+{
+  return m_cells.size ();
+}
+
+void
+InvertibleBloomFilter::Reset (uint32_t cells)
+{
+  cells = std::max (cells, HASH_COUNT);
+  cells += (HASH_COUNT - cells % HASH_COUNT) % HASH_COUNT;
+
+  m_cells.assign (cells, Cell ());
+}
+
+void
+InvertibleBloomFilter::Insert (uint64_t key)
+{
+  Add (key, 1);
+}
+
+void
+InvertibleBloomFilter::Erase (uint64_t key)
+{
+  Add (key, -1);
+}
+
+bool
+InvertibleBloomFilter::Subtract (const InvertibleBloomFilter & other)
+{
+  if (other.m_cells.size () != m_cells.size ()) {
+    return false;
+  }
+  for (uint32_t i = 0; i < m_cells.size (); i++) {
+    m_cells[i].count -= other.m_cells[i].count;
+    m_cells[i].keySum ^= other.m_cells[i].keySum;
+    m_cells[i].hashSum ^= other.m_cells[i].hashSum;
+  }
+  return true;
+}
+
+bool
+InvertibleBloomFilter::Decode (std::vector<uint64_t> & positive, std::vector<uint64_t> & negative) const
+{
+  InvertibleBloomFilter work (*this);
+
+  std::vector<uint32_t> pure;
+  for (uint32_t i = 0; i < work.m_cells.size (); i++) {
+    if (IsPure (work.m_cells[i])) {
+      pure.push_back (i);
+    }
+  }
+
+  while (!pure.empty ()) {
+    Cell cell = work.m_cells[pure.back ()];
+    pure.pop_back ();
+    if (!IsPure (cell)) {  // already peeled through another cell
+      continue;
+    }
+
+    if (cell.count > 0) {
+      positive.push_back (cell.keySum);
+    } else {
+      negative.push_back (cell.keySum);
+    }
+    work.Add (cell.keySum, -cell.count);
+
+    for (uint32_t hash = 0; hash < HASH_COUNT; hash++) {
+      uint32_t index = work.CellIndex (cell.keySum, hash);
+      if (IsPure (work.m_cells[index])) {
+        pure.push_back (index);
+      }
+    }
+  }
+
+  for (std::vector<Cell>::const_iterator cell = work.m_cells.begin ();
+       cell != work.m_cells.end ();
+       cell++) {
+    if (cell->count != 0 || cell->keySum != 0 || cell->hashSum != 0) {
+      NS_LOG_DEBUG ("IBF difference too large to decode");
+      return false;
+    }
+  }
+  return true;
+}
+
+void
+InvertibleBloomFilter::Add (uint64_t key, int32_t count)
+{
+  uint64_t check = CheckHash (key);
+  for (uint32_t hash = 0; hash < HASH_COUNT; hash++) {
+    Cell & cell = m_cells[CellIndex (key, hash)];
+    cell.count += count;
+    cell.keySum ^= key;
+    cell.hashSum ^= check;
+  }
+}
+
+uint32_t
+InvertibleBloomFilter::CellIndex (uint64_t key, uint32_t hash) const
+{
+  // one partition of the cells per hash function, so a key never lands
+  // twice in the same cell
+  uint32_t partition = m_cells.size () / HASH_COUNT;
+  return hash * partition + Mix (key + hash + 1) % partition;
+}
+
+uint64_t
+InvertibleBloomFilter::CheckHash (uint64_t key)
+{
+  return Mix (key ^ 0x5BD1E9955BD1E995ULL);
+}
+
+bool
+InvertibleBloomFilter::IsPure (const Cell & cell)
+{
+  return (cell.count == 1 || cell.count == -1) && cell.hashSum == CheckHash (cell.keySum);
+}
+
+} // namespace ndn
+} // namespace ns3
@@ -0,0 +1,132 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// sync-ibf.h
+
+#ifndef _SYNC_IBF_H
+#define _SYNC_IBF_H
+
+#include "ns3/header.h"
+
+#include <vector>
+
+namespace ns3 {
+namespace ndn {
+
+static const uint32_t DEFAULT_IBF_CELLS = 90;
+
+// ========== Class InvertibleBloomFilter ============
+
+/**
+ * @brief Invertible Bloom filter over 64-bit keys
+ *
+ * Two filters of the same size can be subtracted; if the two key sets differ
+ * by few enough keys, Decode recovers exactly the keys only in this filter
+ * and the keys only in the other one, whatever the size of the sets.
+ *
+ * SyncState keeps one over the hashes of its (id, seq) entries.
+ */
+class InvertibleBloomFilter : public Header, public SimpleRefCount<InvertibleBloomFilter> {
+
+public:
+  struct Cell
+  {
+    int32_t count;
+    uint64_t keySum;
+    uint64_t hashSum;
+
+    Cell ()
+    : count (0), keySum (0), hashSum (0)
+    {}
+  };
+
+  static const uint32_t HASH_COUNT = 3;
+
+  InvertibleBloomFilter (uint32_t cells = DEFAULT_IBF_CELLS);
+  virtual ~InvertibleBloomFilter ();
+
+  static TypeId
+  GetTypeId (void);
+
+  virtual TypeId
+  GetInstanceTypeId (void) const;
+
+  void
+  Print (std::ostream &os) const;
+
+  uint32_t
+  GetSerializedSize (void) const;
+
+  void
+  Serialize (Buffer::Iterator start) const;
+
+  /// A truncated or malformed filter is read as one without cells
+  uint32_t
+  Deserialize (Buffer::Iterator start);
+
+  uint32_t
+  GetCellCount () const;
+
+  /// Resize and empty the filter; cells are rounded up to a multiple of HASH_COUNT
+  void
+  Reset (uint32_t cells);
+
+  void
+  Insert (uint64_t key);
+
+  void
+  Erase (uint64_t key);
+
+  /// this -= other; both must have the same number of cells
+  bool
+  Subtract (const InvertibleBloomFilter & other);
+
+  /**
+   * @brief Peel the filter, which is normally the difference of two filters
+   *
+   * @param positive keys inserted more often than erased (only in the minuend)
+   * @param negative keys erased more often than inserted (only in the subtrahend)
+   * @returns false if the difference was too large to be decoded completely
+   */
+  bool
+  Decode (std::vector<uint64_t> & positive, std::vector<uint64_t> & negative) const;
+
+private:
+  void
+  Add (uint64_t key, int32_t count);
+
+  uint32_t
+  CellIndex (uint64_t key, uint32_t hash) const;
+
+  static uint64_t
+  CheckHash (uint64_t key);
+
+  static bool
+  IsPure (const Cell & cell);
+
+private:
+  std::vector<Cell> m_cells;
+
+}; // class InvertibleBloomFilter
+
+} // namespace ndn
+} // namespace ns3
+
+#endif /* _SYNC_IBF_H */
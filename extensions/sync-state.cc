@@ -23,6 +23,10 @@
 #include "sync-state.h"
 #include "ns3/assert.h"
 #include "ns3/log.h"
+#include "ns3/simulator.h"
+
+#include <algorithm>
+#include <limits>
 
 NS_LOG_COMPONENT_DEFINE ("SyncState");
 
@@ -31,9 +35,13 @@ namespace ndn {
 
 // ========== Class SyncState ============
 
-#define MAX_LOG_LENGTH 10000
-
 SyncState::SyncState ()
+  : m_digestLog (DEFAULT_MAX_LOG_LENGTH)
+  , m_changeLog (DEFAULT_MAX_LOG_CHANGES)
+  , m_batchDigest (INITIAL_DIGEST)
+  , m_batchFirstChange (0)
+  , m_batchChangeCount (0)
+  , m_idLifetime (Seconds (0))
 { 
 }
 
@@ -56,29 +64,135 @@ SyncState::GetInstanceTypeId (void) const
 
 /// ========================= 
 
+namespace {
+
+const uint64_t NO_SEQ = std::numeric_limits<uint64_t>::max ();
+
+bool
+IsUnreservedChar (uint8_t c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+         c == '-' || c == '_' || c == '+' || c == '.';
+}
+
+int
+HexValue (char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+} // anonymous namespace
+
 std::string &
-SyncState::IdSeqToName (const std::string id, uint64_t seq, std::string & name)
+SyncState::IdSeqToName (const std::string & id, uint64_t seq, std::string & name)
 {
-  Ptr<ndn::Name> s = Create<ndn::Name> (id);
+  static const char hex[] = "0123456789ABCDEF";
 
-  s->appendNumber (seq);
-  name = s->toUri ();
+  name.reserve (id.size () + 1 + 3 * sizeof (seq));
+  name = id;
+  name.push_back ('/');
 
+  // big-endian, without leading zero bytes, same as ndn::Name::appendNumber
+  // followed by toUri: 0 is the empty component
+  int shift = 56;
+  while (shift >= 0 && ((seq >> shift) & 0xFF) == 0) {
+    shift -= 8;
+  }
+  bool allPeriods = true;
+  for (int s = shift; s >= 0; s -= 8) {
+    allPeriods = allPeriods && ((seq >> s) & 0xFF) == '.';
+  }
+  if (allPeriods) {
+    // a component of periods only, or none, takes three more
+    name.append ("...");
+  }
+  for (; shift >= 0; shift -= 8) {
+    uint8_t c = (seq >> shift) & 0xFF;
+    if (IsUnreservedChar (c)) {
+      name.push_back (c);
+    } else {
+      name.push_back ('%');
+      name.push_back (hex[c >> 4]);
+      name.push_back (hex[c & 0x0F]);
+    }
+  }
   return name;
 }
 
 void
-SyncState::NameToIdSeq (const std::string name, std::string & id, uint64_t & seq)
+SyncState::NameToIdSeq (const std::string & name, std::string & id, uint64_t & seq)
+{
+  size_t idLength = 0;
+  seq = 0;
+  ParseName (name, idLength, seq);
+  id.assign (name, 0, idLength);
+}
+
+bool
+SyncState::ParseName (const std::string & name, size_t & idLength, uint64_t & seq)
+{
+  return ParseName (name.data (), name.size (), idLength, seq);
+}
+
+bool
+SyncState::ParseName (const char * name, size_t size, size_t & idLength, uint64_t & seq)
+{
+  size_t slash = size;
+  while (slash > 0 && name[slash - 1] != '/') {
+    slash--;
+  }
+  if (slash-- <= 1 || slash + 1 == size) {
+    return false;
+  }
+
+  uint64_t value = 0;
+  uint32_t bytes = 0;
+  size_t begin = slash + 1;
+  size_t period = begin;
+  while (period < size && name[period] == '.') {
+    period++;
+  }
+  if (period == size && size - begin >= 3) {
+    begin += 3;  // the periods added by IdSeqToName
+  }
+  for (size_t i = begin; i < size; i++, bytes++) {
+    uint8_t c = name[i];
+    if (c == '%') {
+      if (i + 2 >= size) {
+        return false;
+      }
+      int high = HexValue (name[i + 1]);
+      int low = HexValue (name[i + 2]);
+      if (high < 0 || low < 0) {
+        return false;
+      }
+      c = (high << 4) | low;
+      i += 2;
+    }
+    value = (value << 8) | c;
+  }
+  if (bytes > sizeof (value)) {
+    return false;
+  }
+
+  idLength = slash;
+  seq = value;
+  return true;
+}
+
+bool
+SyncState::IsTombstone (uint64_t seq)
 {
-  Ptr<ndn::Name> n = Create<ndn::Name> (name);
-  id = n->getPrefix (n->size () - 1).toUri ();
-  seq = n->get (-1).toNumber ();
+  return (seq & TOMBSTONE_BIT) != 0;
 }
 
 uint64_t
 SyncState::GetCurrentDigest () const
 {
-  return m_digestLog.empty ()?  INITIAL_DIGEST : m_digestLog.front ().digest;
+  return m_digestLog.Empty ()?  INITIAL_DIGEST : m_digestLog.Newest ().digest;
 }
 
 bool
@@ -90,18 +204,19 @@ SyncState::IsCurrentDigest (uint64_t digest) const
 bool
 SyncState::IsDigestInLog (uint64_t digest) const
 {
-  return (FindDigestInLog (digest) != m_digestLog.end ());
+  DigestLog::Position position;
+  return FindDigestInLog (digest, position);
 }
 
 uint64_t
 SyncState::GetSyncDigest () const
 {
- for (DigestLog::const_iterator i = m_digestLog.begin ();
-       i != m_digestLog.end ();
-       i++)
+  for (DigestLog::Position i = m_digestLog.End ();
+       i-- != m_digestLog.Begin ();
+       )
   {
-    if (i->counter > 0) {
-      return i->digest;
+    if (m_digestLog[i].counter > 0) {
+      return m_digestLog[i].digest;
     }
   }
   return INITIAL_DIGEST;
@@ -110,47 +225,120 @@ SyncState::GetSyncDigest () const
 bool
 SyncState::IncreaseCounter (uint64_t digest)
 {
-  DigestLog::iterator i = FindDigestInLog (digest);
-  if (i != m_digestLog.end ())
+  DigestLog::Position i;
+  if (FindDigestInLog (digest, i))
   {
-      i->counter ++;
+      m_digestLog[i].counter ++;
       return true;
   }
   return false;
 }
 
 uint64_t
-SyncState::IncrementalHash (const std::string & newName, const std::string & oldName) const
+SyncState::EntryHash (uint64_t idHash, uint64_t seq)
 {
-  if (oldName == "") {
-    return GetCurrentDigest() ^ ns3::Hash64(newName);
-  } else {
-    return GetCurrentDigest() ^ ns3::Hash64(newName) ^ ns3::Hash64 (oldName);
+  // splitmix64 finalizer over the id hash and the seq
+  uint64_t h = idHash + seq * 0x9E3779B97F4A7C15ULL;
+  h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+  return h ^ (h >> 31);
+}
+
+void
+SyncState::AddToLog (uint64_t digest, ChangeLog::Position firstChange, uint32_t changeCount)
+{
+  if (m_digestLog.Full ()) {
+    EvictOldest ();
   }
+
+  m_digestLog.Push () = LogTuple (digest, firstChange, changeCount);
+  m_digestIndex[digest] = m_digestLog.End () - 1;
+  NS_LOG_DEBUG ("digest: " << digest << " changes: " << changeCount);
+
+  // the changes just written may have recycled slots of the oldest entries
+  EvictStaleEntries ();
 }
 
 void
-SyncState::AddToLog (uint64_t digest, const std::string & newName, const std::string & oldName)
+SyncState::EvictOldest ()
 {
-  LogTuple logTuple (digest, newName, oldName);
-  m_digestLog.push_front (logTuple);
-  NS_LOG_DEBUG ("digest: " << digest << "lsuName: " << newName << "oldName: " << oldName);
+  // the same digest may appear more than once; only drop the index entry
+  // if it still points at the tuple being evicted
+  uint64_t digest = m_digestLog.Oldest ().digest;
+  DigestIndex::iterator i = m_digestIndex.find (digest);
+  bool evicted = (i != m_digestIndex.end () && i->second == m_digestLog.Begin ());
+  if (evicted) {
+    m_digestIndex.erase (i);
+  }
+  m_digestLog.PopOldest ();
 
-  if (m_digestLog.size () > MAX_LOG_LENGTH) {
-    m_digestLog.pop_back ();
+  if (evicted) {
+    OnDigestEvicted (digest);
   }
 }
 
+void
+SyncState::OnDigestEvicted (uint64_t digest)
+{
+}
+
+void
+SyncState::OnNameUpdated (const std::string & id, uint64_t seq)
+{
+}
+
+bool
+SyncState::IsExpiringId (const std::string & id) const
+{
+  return true;
+}
+
+void
+SyncState::EvictStaleEntries ()
+{
+  while (!m_digestLog.Empty () && m_digestLog.Oldest ().firstChange < m_changeLog.Begin ()) {
+    EvictOldest ();
+  }
+}
+
+void
+SyncState::RebuildDigestIndex ()
+{
+  m_digestIndex.clear ();
+  for (DigestLog::Position i = m_digestLog.Begin (); i != m_digestLog.End (); i++) {
+    m_digestIndex[m_digestLog[i].digest] = i;
+  }
+}
+
+void
+SyncState::AppendName (IdHandle id, uint64_t seq, NameList & nameList) const
+{
+  nameList.push_back (std::string ());
+  IdSeqToName (m_idNames[id], seq, nameList.back ());
+}
+
 void
 SyncState::GetAllName (NameList & nameList) const
 {
-  std::string str;
-  for (IdSeqMap::const_iterator i = m_idSeqMap.begin ();
-       i != m_idSeqMap.end ();
+  nameList.reserve (nameList.size () + m_idSeqMap.size ());
+  for (IdHandle i = 0; i < m_idSeqMap.size (); i++)
+  {
+    if (m_idSeqMap[i] != 0) {
+      AppendName (i, m_idSeqMap[i], nameList);
+    }
+  }
+}
+
+void
+SyncState::ResetScratch () const
+{
+  for (std::vector<IdHandle>::const_iterator i = m_scratchIds.begin ();
+       i != m_scratchIds.end ();
        i++)
   {
-    nameList.push_back (IdSeqToName (i->first, i->second, str));
+    m_scratchSeq[*i] = NO_SEQ;
   }
+  m_scratchIds.clear ();
 }
 
 bool
@@ -160,36 +348,41 @@ SyncState::GetUpdateByThen (uint64_t digest, NameList & nameList) const
     GetAllName (nameList);
     return true;
   } 
-  if (IsDigestInLog (digest) == false) {
+  DigestLog::Position target;
+  if (FindDigestInLog (digest, target) == false) {
     return false;
   }
-  // To-Do: there must be more efficient way
-  std::map<std::string, bool > nameMap;  // the 2nd 'bool' is only a placeholder
-  for (IdSeqMap::const_iterator i = m_idSeqMap.begin ();
-       i != m_idSeqMap.end ();
-       i++)
-  {
-    std::string str;
-    nameMap[IdSeqToName (i->first, i->second, str)] = true;
-  }
 
-  for (DigestLog::const_iterator i = m_digestLog.begin ();
-       i != m_digestLog.end ();
-       i++)
+  // Replay the undo records of the entries newer than the target, newest
+  // first, so the seq left for each touched id is the one it had back then.
+  // This is proportional to the number of intervening updates; ids that were
+  // not touched since then are emitted with their current seq.
+  for (DigestLog::Position i = m_digestLog.End () - 1;
+       i != target;
+       i--)
   {
-    if (digest != i->digest) {
-      nameMap.erase (i->newName);
-      nameMap[i->oldName] = true;
-    } else {
-      break;
+    const LogTuple & logTuple = m_digestLog[i];
+    for (ChangeLog::Position c = logTuple.firstChange + logTuple.changeCount;
+         c-- != logTuple.firstChange;
+         )
+    {
+      const LogChange & change = m_changeLog[c];
+      if (m_scratchSeq[change.id] == NO_SEQ) {
+        m_scratchIds.push_back (change.id);
+      }
+      m_scratchSeq[change.id] = change.oldSeq;
     }
   }
-  for (std::map<std::string, bool >::const_iterator i = nameMap.begin ();
-       i != nameMap.end ();
-       i++)
+
+  nameList.reserve (nameList.size () + m_idSeqMap.size ());
+  for (IdHandle i = 0; i < m_idSeqMap.size (); i++)
   {
-    nameList.push_back (i->first);
+    uint64_t seq = m_scratchSeq[i] == NO_SEQ ? m_idSeqMap[i] : m_scratchSeq[i];
+    if (seq != 0) {  // 0: the id did not exist yet at the target digest
+      AppendName (i, seq, nameList);
+    }
   }
+  ResetScratch ();
   return true;
 }
 
@@ -200,37 +393,102 @@ SyncState::GetUpdateInbetween (uint64_t oldDigest, uint64_t newDigest, NameList
     return GetUpdateByThen (newDigest, nameList);
   }
 
-  // To-Do: there must be more efficient way
-  std::map<std::string, bool > nameMap;  // the 2nd 'bool' is only a placeholder
-
-  DigestLog::const_iterator i = m_digestLog.begin ();
-  for (; i != m_digestLog.end (); i++)
-  {
-    if (newDigest == i->digest) break;
-  }
-  DigestLog::const_iterator j = i;
-  for (; j != m_digestLog.end (); j++)
-  {
-    if (oldDigest == j->digest) break;
-    nameMap[j->newName] = true;
-  }
-  if (j == m_digestLog.end ()) {
+  DigestLog::Position i, j;
+  if (FindDigestInLog (newDigest, i) == false ||
+      FindDigestInLog (oldDigest, j) == false ||
+      j > i) {
     return false;
   }
 
-  for (; j != i; j--) {
-    nameMap.erase (j->oldName);
+  // newest seq of every id advanced after oldDigest, up to newDigest
+  for (DigestLog::Position k = i; k != j; k--) {
+    const LogTuple & logTuple = m_digestLog[k];
+    for (ChangeLog::Position c = logTuple.firstChange + logTuple.changeCount;
+         c-- != logTuple.firstChange;
+         )
+    {
+      const LogChange & change = m_changeLog[c];
+      if (m_scratchSeq[change.id] == NO_SEQ) {
+        m_scratchSeq[change.id] = change.newSeq;
+        m_scratchIds.push_back (change.id);
+      }
+    }
   }
-  nameMap.erase (j->oldName);
-  for (std::map<std::string, bool >::const_iterator i = nameMap.begin ();
-       i != nameMap.end ();
-       i++)
+
+  nameList.reserve (nameList.size () + m_scratchIds.size ());
+  for (std::vector<IdHandle>::const_iterator k = m_scratchIds.begin ();
+       k != m_scratchIds.end ();
+       k++)
   {
-    nameList.push_back (i->first);
+    if (m_scratchSeq[*k] != 0) {  // 0: dropped since oldDigest
+      AppendName (*k, m_scratchSeq[*k], nameList);
+    }
   }
+  ResetScratch ();
   return true;
 }
 
+void
+SyncState::GetUpdatesInbetween (const std::vector<uint64_t> & oldDigests, uint64_t newDigest,
+                                std::map<uint64_t, NameList> & updates) const
+{
+  DigestLog::Position newPosition;
+  bool newInLog = FindDigestInLog (newDigest, newPosition);
+
+  std::vector<std::pair<DigestLog::Position, uint64_t> > targets;
+  for (std::vector<uint64_t>::const_iterator i = oldDigests.begin (); i != oldDigests.end (); i++) {
+    DigestLog::Position position;
+    if (*i == INITIAL_DIGEST) {
+      NameList nameList;
+      if (GetUpdateByThen (newDigest, nameList)) {
+        updates[*i].swap (nameList);
+      }
+    } else if (newInLog && FindDigestInLog (*i, position) && position <= newPosition) {
+      targets.push_back (std::make_pair (position, *i));
+    }
+  }
+  if (targets.empty ()) {
+    return;
+  }
+  // newest target first
+  std::sort (targets.begin (), targets.end ());
+  std::reverse (targets.begin (), targets.end ());
+
+  std::vector<std::pair<DigestLog::Position, uint64_t> >::const_iterator target = targets.begin ();
+  for (DigestLog::Position k = newPosition; ; k--) {
+    // the changes accumulated so far are exactly those after the entry at k
+    for (; target != targets.end () && target->first == k; target++) {
+      NameList & nameList = updates[target->second];
+      nameList.clear ();  // a digest listed twice is answered once
+      nameList.reserve (m_scratchIds.size ());
+      for (std::vector<IdHandle>::const_iterator i = m_scratchIds.begin ();
+           i != m_scratchIds.end ();
+           i++)
+      {
+        if (m_scratchSeq[*i] != 0) {
+          AppendName (*i, m_scratchSeq[*i], nameList);
+        }
+      }
+    }
+    if (target == targets.end ()) {
+      break;
+    }
+
+    const LogTuple & logTuple = m_digestLog[k];
+    for (ChangeLog::Position c = logTuple.firstChange + logTuple.changeCount;
+         c-- != logTuple.firstChange;
+         )
+    {
+      const LogChange & change = m_changeLog[c];
+      if (m_scratchSeq[change.id] == NO_SEQ) {
+        m_scratchSeq[change.id] = change.newSeq;
+        m_scratchIds.push_back (change.id);
+      }
+    }
+  }
+  ResetScratch ();
+}
+
 bool
 SyncState::GetUpdateSinceThen (uint64_t digest, NameList & nameList) const
 {
@@ -242,61 +500,376 @@ SyncState::GetUpdateSinceThen (uint64_t digest, NameList & nameList) const
 }
 
 bool
-SyncState::Update (const std::string & newName, std::string & oldName)
+SyncState::Update (const std::string & newName)
+{
+  BeginBatch ();
+  bool isNew = StageName (newName.data (), newName.size ());
+  CommitBatch ();
+  return isNew;
+}
+
+bool
+SyncState::Update (const std::string & id, uint64_t seq)
+{
+  BeginBatch ();
+  bool isNew = StageUpdate (id.data (), id.size (), seq);
+  CommitBatch ();
+  return isNew;
+}
+
+bool
+SyncState::Update (const NameList & nameList)
+{
+  bool hasNew = false;
+
+  BeginBatch ();
+  for (NameList::const_iterator i = nameList.begin (); i != nameList.end (); i++) {
+    if (StageName (i->data (), i->size ())) {
+      hasNew = true;
+    }
+  }
+  CommitBatch ();
+  return hasNew;
+}
+
+bool
+SyncState::Update (const NameSpanList & nameList)
+{
+  bool hasNew = false;
+
+  BeginBatch ();
+  for (NameSpanList::const_iterator i = nameList.begin (); i != nameList.end (); i++) {
+    if (StageName (i->data, i->size)) {
+      hasNew = true;
+    }
+  }
+  CommitBatch ();
+  return hasNew;
+}
+
+void
+SyncState::BeginBatch ()
+{
+  m_batchDigest = GetCurrentDigest ();
+  m_batchFirstChange = m_changeLog.End ();
+  m_batchChangeCount = 0;
+}
+
+bool
+SyncState::StageName (const char * name, size_t size)
 {
-  std::string id;
+  size_t idLength;
   uint64_t seq;
-  NameToIdSeq (newName, id, seq);
+  if (ParseName (name, size, idLength, seq) == false) {
+    NS_LOG_DEBUG ("Malformed name: " << std::string (name, size));
+    return false;
+  }
+  return StageUpdate (name, idLength, seq);
+}
 
-  oldName.clear ();
+bool
+SyncState::StageUpdate (const char * id, size_t idLength, uint64_t seq)
+{
+  if (seq == 0) {
+    NS_LOG_DEBUG ("Zero seq: " << std::string (id, idLength));
+    return false;
+  }
 
-  IdSeqMap::iterator i = m_idSeqMap.find (id);
-  if (i != m_idSeqMap.end ()) {
-    if (seq > i->second) {
-      IdSeqToName (i->first, i->second, oldName);
-      i->second = seq;
-      NS_LOG_DEBUG ("New name: " << newName << " Old name: " << oldName);
-    } else {
-      NS_LOG_DEBUG ("Old name: " << newName);
+  uint64_t idHash = ns3::Hash64 (id, idLength);
+  IdHandle handle;
+  if (FindId (id, idLength, idHash, handle) == false) {
+    // a tombstone only retires an id we hold: taking one for an id we never
+    // had, or dropped already, would keep it for another lifetime, and the
+    // routers would hand it back and forth forever
+    if (IsTombstone (seq)) {
+      NS_LOG_DEBUG ("Tombstone of no id held: " << std::string (id, idLength));
       return false;
     }
-  } else {
-    m_idSeqMap[id] = seq;
-    NS_LOG_DEBUG ("New name: " << newName);
+    handle = InternId (id, idLength, idHash);
+  } else if (IsTombstone (seq) && !IsExpiringId (m_idNames[handle])) {
+    NS_LOG_DEBUG ("Tombstone of an id that does not expire: " << m_idNames[handle]);
+    return false;
   }
-  AddToLog (IncrementalHash (newName, oldName), newName, oldName);
+
+  uint64_t oldSeq = m_idSeqMap[handle];
+  if (oldSeq >= seq) {
+    NS_LOG_DEBUG ("Old name: " << m_idNames[handle] << " " << seq);
+    return false;
+  }
+  NS_LOG_DEBUG ("New name: " << m_idNames[handle] << " " << seq << " Old seq: " << oldSeq);
+
+  StageChange (handle, seq);
   return true;
 }
 
-DigestLog::const_iterator
-SyncState::FindDigestInLog (uint64_t digest) const
+void
+SyncState::StageChange (IdHandle handle, uint64_t seq)
 {
-  DigestLog::const_iterator i = m_digestLog.begin ();
-  for (;
-       i != m_digestLog.end ();
-       i++)
-  {
-    if (digest == i->digest) {
-      break;
+  // a batch that would not fit in the change log is committed in pieces
+  if (m_batchChangeCount == m_changeLog.GetCapacity ()) {
+    CommitBatch ();
+    BeginBatch ();
+  }
+
+  uint64_t idHash = m_idHashes[handle];
+  uint64_t oldSeq = m_idSeqMap[handle];
+  m_changeLog.Push () = LogChange (handle, seq, oldSeq);
+  m_batchChangeCount++;
+
+  if (seq != 0) {
+    uint64_t entryHash = EntryHash (idHash, seq);
+    m_batchDigest ^= entryHash;
+    m_ibf.Insert (entryHash);
+    m_entryIndex[entryHash] = handle;
+  }
+  if (oldSeq != 0) {
+    uint64_t oldEntryHash = EntryHash (idHash, oldSeq);
+    m_batchDigest ^= oldEntryHash;
+    m_ibf.Erase (oldEntryHash);
+    m_entryIndex.erase (oldEntryHash);
+  }
+  m_idSeqMap[handle] = seq;
+
+  m_idUpdated[handle] = Simulator::Now ();
+  if (seq == 0) {
+    return;
+  }
+  if (m_idLifetime.IsStrictlyPositive () && IsExpiringId (m_idNames[handle])) {
+    m_expiryQueue.push_back (std::make_pair (m_idUpdated[handle], handle));
+  }
+  OnNameUpdated (m_idNames[handle], seq);
+}
+
+void
+SyncState::CommitBatch ()
+{
+  if (m_batchChangeCount == 0) {
+    return;
+  }
+  AddToLog (m_batchDigest, m_batchFirstChange, m_batchChangeCount);
+  m_batchChangeCount = 0;
+}
+
+bool
+SyncState::FindId (const char * id, size_t idLength, uint64_t idHash, IdHandle & handle) const
+{
+  typedef boost::unordered_multimap<uint64_t, IdHandle>::const_iterator LookupIterator;
+  std::pair<LookupIterator, LookupIterator> range = m_idLookup.equal_range (idHash);
+  for (LookupIterator i = range.first; i != range.second; i++) {
+    if (m_idNames[i->second].compare (0, std::string::npos, id, idLength) == 0) {
+      handle = i->second;
+      return true;
     }
   }
-  return i;
+  return false;
 }
 
-DigestLog::iterator
-SyncState::FindDigestInLog (uint64_t digest)
+IdHandle
+SyncState::InternId (const char * id, size_t idLength, uint64_t idHash)
 {
-  DigestLog::iterator i = m_digestLog.begin ();
-  for (;
-       i != m_digestLog.end ();
-       i++)
-  {
-    if (digest == i->digest) {
+  IdHandle handle;
+  if (!m_releasedIds.empty () && m_releasedIds.front ().first < m_changeLog.Begin ()) {
+    handle = m_releasedIds.front ().second;
+    m_releasedIds.pop_front ();
+    m_idNames[handle].assign (id, idLength);
+    m_idHashes[handle] = idHash;
+  } else {
+    handle = m_idNames.size ();
+    m_idNames.push_back (std::string (id, idLength));
+    m_idHashes.push_back (idHash);
+    m_idSeqMap.push_back (0);
+    m_idUpdated.push_back (Time ());
+    m_scratchSeq.push_back (NO_SEQ);
+  }
+  m_idLookup.insert (std::make_pair (idHash, handle));
+  return handle;
+}
+
+void
+SyncState::ReleaseId (IdHandle handle)
+{
+  typedef boost::unordered_multimap<uint64_t, IdHandle>::iterator LookupIterator;
+  std::pair<LookupIterator, LookupIterator> range = m_idLookup.equal_range (m_idHashes[handle]);
+  for (LookupIterator i = range.first; i != range.second; i++) {
+    if (i->second == handle) {
+      m_idLookup.erase (i);
       break;
     }
   }
-  return i;
+  // the name stays for the logged diffs that still reach the id
+  m_releasedIds.push_back (std::make_pair (m_changeLog.End () - 1, handle));
+}
+
+Time
+SyncState::GetIdLifetime () const
+{
+  return m_idLifetime;
+}
+
+void
+SyncState::SetIdLifetime (Time lifetime)
+{
+  m_idLifetime = lifetime;
+  RebuildExpiryQueue ();
+}
+
+void
+SyncState::RebuildExpiryQueue ()
+{
+  m_expiryQueue.clear ();
+  if (!m_idLifetime.IsStrictlyPositive ()) {
+    return;
+  }
+  for (IdHandle i = 0; i < m_idSeqMap.size (); i++) {
+    if (m_idSeqMap[i] != 0 && IsExpiringId (m_idNames[i])) {
+      m_expiryQueue.push_back (std::make_pair (m_idUpdated[i], i));
+    }
+  }
+  std::sort (m_expiryQueue.begin (), m_expiryQueue.end ());
+}
+
+uint32_t
+SyncState::ExpireIds ()
+{
+  Time now = Simulator::Now ();
+  uint32_t expired = 0;
+
+  BeginBatch ();
+  while (!m_expiryQueue.empty () && m_expiryQueue.front ().first + m_idLifetime <= now) {
+    Time updated = m_expiryQueue.front ().first;
+    IdHandle handle = m_expiryQueue.front ().second;
+    m_expiryQueue.pop_front ();
+
+    uint64_t seq = m_idSeqMap[handle];
+    if (seq == 0 || m_idUpdated[handle] != updated) {  // dropped or updated since
+      continue;
+    }
+
+    if (IsTombstone (seq)) {
+      NS_LOG_DEBUG ("Drop tombstone: " << m_idNames[handle]);
+      StageChange (handle, 0);
+      ReleaseId (handle);
+    } else {
+      NS_LOG_DEBUG ("Tombstone: " << m_idNames[handle] << " " << seq);
+      StageChange (handle, seq | TOMBSTONE_BIT);
+    }
+    expired++;
+  }
+  CommitBatch ();
+  return expired;
+}
+
+bool
+SyncState::GetNextExpiry (Time & when) const
+{
+  if (m_expiryQueue.empty ()) {
+    return false;
+  }
+  when = m_expiryQueue.front ().first + m_idLifetime;
+  return true;
+}
+
+uint32_t
+SyncState::GetIdCount () const
+{
+  return m_idSeqMap.size () - m_releasedIds.size ();
+}
+
+uint64_t
+SyncState::GetSeq (const std::string & id) const
+{
+  IdHandle handle;
+  if (FindId (id.data (), id.size (), ns3::Hash64 (id.data (), id.size ()), handle) == false) {
+    return 0;
+  }
+  return m_idSeqMap[handle];
+}
+
+const InvertibleBloomFilter &
+SyncState::GetIbf () const
+{
+  return m_ibf;
+}
+
+uint32_t
+SyncState::GetIbfCells () const
+{
+  return m_ibf.GetCellCount ();
+}
+
+void
+SyncState::SetIbfCells (uint32_t cells)
+{
+  m_ibf.Reset (cells);
+  for (IdHandle i = 0; i < m_idSeqMap.size (); i++) {
+    if (m_idSeqMap[i] != 0) {
+      m_ibf.Insert (EntryHash (m_idHashes[i], m_idSeqMap[i]));
+    }
+  }
+}
+
+bool
+SyncState::GetUpdateByIbf (const InvertibleBloomFilter & remoteIbf, NameList & nameList) const
+{
+  InvertibleBloomFilter difference (m_ibf);
+  if (difference.Subtract (remoteIbf) == false) {
+    NS_LOG_DEBUG ("IBF size mismatch: " << remoteIbf.GetCellCount () << " " << m_ibf.GetCellCount ());
+    return false;
+  }
+
+  std::vector<uint64_t> localOnly;
+  std::vector<uint64_t> remoteOnly;
+  if (difference.Decode (localOnly, remoteOnly) == false) {
+    return false;
+  }
+  NS_LOG_DEBUG ("IBF decoded, local only: " << localOnly.size () << " remote only: " << remoteOnly.size ());
+
+  nameList.reserve (nameList.size () + localOnly.size ());
+  for (std::vector<uint64_t>::const_iterator i = localOnly.begin (); i != localOnly.end (); i++) {
+    boost::unordered_map<uint64_t, IdHandle>::const_iterator entry = m_entryIndex.find (*i);
+    if (entry != m_entryIndex.end ()) {
+      AppendName (entry->second, m_idSeqMap[entry->second], nameList);
+    }
+  }
+  return true;
+}
+
+uint32_t
+SyncState::GetMaxLogLength () const
+{
+  return m_digestLog.GetCapacity ();
+}
+
+void
+SyncState::SetMaxLogLength (uint32_t length)
+{
+  m_digestLog.SetCapacity (length);
+  RebuildDigestIndex ();
+}
+
+uint32_t
+SyncState::GetMaxLogChanges () const
+{
+  return m_changeLog.GetCapacity ();
+}
+
+void
+SyncState::SetMaxLogChanges (uint32_t changes)
+{
+  m_changeLog.SetCapacity (changes);
+  EvictStaleEntries ();
+}
+
+bool
+SyncState::FindDigestInLog (uint64_t digest, DigestLog::Position & position) const
+{
+  DigestIndex::const_iterator i = m_digestIndex.find (digest);
+  if (i == m_digestIndex.end ()) {
+    return false;
+  }
+  position = i->second;
+  return true;
 }
 
 } // namespace ndn
-} // namespace ns3
\ No newline at end of file
+} // namespace ns3
@@ -23,8 +23,15 @@
 #ifndef _SYNC_STATE_H
 #define _SYNC_STATE_H
 
+#include "name-span.h"
+#include "ring-buffer.h"
+#include "sync-ibf.h"
 #include "ns3/header.h"
 #include "ns3/ndn-data.h"
+#include "ns3/nstime.h"
+
+#include <boost/unordered_map.hpp>
+#include <deque>
 
 namespace ns3 {
 namespace ndn {
@@ -32,26 +39,54 @@ namespace ndn {
 /// ========== Class NlsrSync ============
 
 static const uint64_t INITIAL_DIGEST = 7036231242510567892; //  ns3::Hash64 ("YUZHANG")
+static const uint32_t DEFAULT_MAX_LOG_LENGTH = 10000;
+static const uint32_t DEFAULT_MAX_LOG_CHANGES = 20000;
+
+// set in the seq of an expired id: the tombstone outranks every live seq of
+// the id, so it spreads through sync like any other update
+static const uint64_t TOMBSTONE_BIT = 1ULL << 63;
+
+typedef uint32_t IdHandle;  // interned router/unit id, see SyncState::InternId
+
+struct LogChange
+{
+  IdHandle id;      // the id that was advanced
+  uint64_t newSeq;  // 0 if the id was dropped from the state
+  uint64_t oldSeq;  // undo record: seq of the id before the update, 0 if it was new
 
+  LogChange (IdHandle i, uint64_t n, uint64_t o)
+  : id (i), newSeq (n), oldSeq (o)
+  {}
+
+  LogChange ()
+  : id (0), newSeq (0), oldSeq (0)
+  {}
+};
+
+typedef RingBuffer<LogChange> ChangeLog;
+
+// One digest step.  Its changes are m_changeLog[firstChange, firstChange + changeCount),
+// in the order they were applied; a batch update records all of its names in one step.
 struct LogTuple
 {
   uint64_t digest;
-  std::string newName;
-  std::string oldName;
   uint32_t counter;
+  uint32_t changeCount;
+  ChangeLog::Position firstChange;
 
-  LogTuple (uint64_t d, std::string n, std::string o)
-  : digest (d), newName (n), oldName (o), counter (0)
+  LogTuple (uint64_t d, ChangeLog::Position first, uint32_t count)
+  : digest (d), counter (0), changeCount (count), firstChange (first)
   {}
 
   LogTuple ()
-  : counter (0)
+  : digest (0), counter (0), changeCount (0), firstChange (0)
   {}
 };
 
 typedef std::vector<std::string> NameList;
-typedef std::map<std::string, uint64_t> IdSeqMap;
-typedef std::list<LogTuple> DigestLog;
+typedef std::vector<uint64_t> IdSeqMap;  // seq per IdHandle, 0 if the id is not in the state
+typedef RingBuffer<LogTuple> DigestLog;  // oldest entry at Begin (), newest at End () - 1
+typedef boost::unordered_map<uint64_t, DigestLog::Position> DigestIndex; // digest -> newest log entry with it
 
 class SyncState {
 
@@ -67,11 +102,30 @@ public:
   virtual TypeId
   GetInstanceTypeId (void) const;
 
+  /**
+   * @brief Build the URI of an (id, seq) pair, with seq as the last component
+   *        encoded the way ndn::Name::appendNumber and toUri do
+   */
   static std::string &
-  IdSeqToName (const std::string id, uint64_t seq, std::string & name);
+  IdSeqToName (const std::string & id, uint64_t seq, std::string & name);
 
   static void
-  NameToIdSeq (const std::string name, std::string & id, uint64_t & seq);
+  NameToIdSeq (const std::string & name, std::string & id, uint64_t & seq);
+
+  /**
+   * @brief Split a URI produced by IdSeqToName without building an ndn::Name
+   *
+   * @param idLength length of the id prefix of name
+   * @returns false if name does not end in a number component
+   */
+  static bool
+  ParseName (const std::string & name, size_t & idLength, uint64_t & seq);
+
+  static bool
+  ParseName (const char * name, size_t size, size_t & idLength, uint64_t & seq);
+
+  static bool
+  IsTombstone (uint64_t seq);
 
   uint64_t
   GetCurrentDigest () const;
@@ -88,8 +142,127 @@ public:
   bool
   GetUpdateInbetween (uint64_t oldDigest, uint64_t newDigest, NameList & nameList) const;
 
+  /**
+   * @brief GetUpdateInbetween (d, newDigest) for every d of oldDigests in a single log walk
+   *
+   * The diffs of older digests extend those of newer ones, so the log is
+   * walked once down to the oldest digest.  Digests the diff cannot be
+   * computed for get no entry in updates.
+   */
+  void
+  GetUpdatesInbetween (const std::vector<uint64_t> & oldDigests, uint64_t newDigest,
+                       std::map<uint64_t, NameList> & updates) const;
+
+  bool
+  Update (const std::string & newName);
+
+  bool
+  Update (const std::string & id, uint64_t seq);
+
+  /**
+   * @brief Apply a whole name list as a single digest step
+   *
+   * All names that advance the state are recorded in one log entry and
+   * move the digest once, however many there are.
+   *
+   * @returns true if at least one name was new
+   */
+  bool
+  Update (const NameList & nameList);
+
+  /// Same as above for names still sitting in a receive buffer
+  bool
+  Update (const NameSpanList & nameList);
+
+  /// IBF over the hashes of all (id, seq) entries in the state
+  const InvertibleBloomFilter &
+  GetIbf () const;
+
+  uint32_t
+  GetIbfCells () const;
+
+  void
+  SetIbfCells (uint32_t cells);
+
+  /**
+   * @brief Names we have and the owner of remoteIbf does not
+   *
+   * @returns false if remoteIbf does not match our filter size or the
+   *          difference is too large to decode
+   */
+  bool
+  GetUpdateByIbf (const InvertibleBloomFilter & remoteIbf, NameList & nameList) const;
+
+  uint32_t
+  GetMaxLogLength () const;
+
+  void
+  SetMaxLogLength (uint32_t length);
+
+  uint32_t
+  GetMaxLogChanges () const;
+
+  void
+  SetMaxLogChanges (uint32_t changes);
+
+  Time
+  GetIdLifetime () const;
+
+  /// Time after its last update an id is tombstoned, and its tombstone dropped (0 disables)
+  void
+  SetIdLifetime (Time lifetime);
+
+  /**
+   * @brief Tombstone the ids not updated for the id lifetime, and drop the
+   *        tombstones that are that old, as a single digest step
+   *
+   * A tombstone is the seq of the id with TOMBSTONE_BIT set.  All routers
+   * derive the same tombstone for an id, so it moves their digests alike
+   * whether they expire the id themselves or learn the tombstone by sync.
+   * Dropping the tombstone forgets the id locally; digests differ until the
+   * others drop it as well, one lifetime after they saw it.  Meanwhile they
+   * may sync the tombstone back to us, but a tombstone is only taken for an
+   * id still held, so a dropped one stays dropped.
+   *
+   * @returns the number of ids tombstoned or dropped
+   */
+  uint32_t
+  ExpireIds ();
+
+  /// @returns false if no id can expire, else when ExpireIds may have work
   bool
-  Update (const std::string & newName, std::string & oldName);
+  GetNextExpiry (Time & when) const;
+
+  /// Number of ids in the state, tombstones included
+  uint32_t
+  GetIdCount () const;
+
+  /// Seq of id in the state, 0 if it has none
+  uint64_t
+  GetSeq (const std::string & id) const;
+
+protected:
+  /// Called when digest drops out of the log, i.e. IsDigestInLog (digest) just became false
+  virtual void
+  OnDigestEvicted (uint64_t digest);
+
+  /**
+   * @brief Called when id advances to seq, tombstones included, whether
+   *        by a local or a received update
+   *
+   * It runs in the middle of the update, which must not be re-entered.
+   */
+  virtual void
+  OnNameUpdated (const std::string & id, uint64_t seq);
+
+  /**
+   * @brief Whether id is tombstoned after the id lifetime (the default)
+   *
+   * An id that is not never expires here, and tombstones of it received
+   * by sync are refused; all routers must agree on it.
+   */
+  virtual bool
+  IsExpiringId (const std::string & id) const;
 
 private:
 
@@ -97,16 +270,52 @@ private:
   IsCurrentDigest (uint64_t digest) const;
 
   void
-  AddToLog (uint64_t digest, const std::string & newName, const std::string & oldName);
+  AddToLog (uint64_t digest, ChangeLog::Position firstChange, uint32_t changeCount);
 
-  uint64_t
-  IncrementalHash (const std::string & newName, const std::string & oldName) const;
+  void
+  EvictOldest ();
+
+  void
+  EvictStaleEntries ();
+
+  void
+  RebuildDigestIndex ();
+
+  static uint64_t
+  EntryHash (uint64_t idHash, uint64_t seq);
+
+  void
+  BeginBatch ();
+
+  bool
+  StageUpdate (const char * id, size_t idLength, uint64_t seq);
+
+  void
+  StageChange (IdHandle handle, uint64_t seq);
 
-  DigestLog::const_iterator
-  FindDigestInLog (uint64_t digest) const;
+  bool
+  StageName (const char * name, size_t size);
 
-  DigestLog::iterator
-  FindDigestInLog (uint64_t digest);
+  void
+  CommitBatch ();
+
+  bool
+  FindId (const char * id, size_t idLength, uint64_t idHash, IdHandle & handle) const;
+
+  IdHandle
+  InternId (const char * id, size_t idLength, uint64_t idHash);
+
+  void
+  ReleaseId (IdHandle handle);
+
+  void
+  RebuildExpiryQueue ();
+
+  bool
+  FindDigestInLog (uint64_t digest, DigestLog::Position & position) const;
+
+  void
+  AppendName (IdHandle id, uint64_t seq, NameList & nameList) const;
 
   void
   GetAllName (NameList & nameList) const;
@@ -117,9 +326,42 @@ private:
   bool
   GetUpdateByThen (uint64_t digest, NameList & nameList) const;
 
+  void
+  ResetScratch () const;
+
 private:
   DigestLog m_digestLog;
+  ChangeLog m_changeLog;
+  DigestIndex m_digestIndex;
   IdSeqMap m_idSeqMap;
+
+  // the batch being staged: digest so far, its first change and change count
+  uint64_t m_batchDigest;
+  ChangeLog::Position m_batchFirstChange;
+  uint32_t m_batchChangeCount;
+
+  // IBF over EntryHash (id, seq) of the state, and EntryHash -> id of the live entries
+  InvertibleBloomFilter m_ibf;
+  boost::unordered_map<uint64_t, IdHandle> m_entryIndex;
+
+  // id interning: the URI and Hash64 of each IdHandle, and Hash64 -> handles
+  std::vector<std::string> m_idNames;
+  std::vector<uint64_t> m_idHashes;
+  boost::unordered_multimap<uint64_t, IdHandle> m_idLookup;
+
+  // id expiry: last update of each IdHandle, and (update time, id) in
+  // update order, with stale pairs left in until they reach the front
+  Time m_idLifetime;
+  std::vector<Time> m_idUpdated;
+  std::deque<std::pair<Time, IdHandle> > m_expiryQueue;
+
+  // dropped ids and the change that dropped them; a handle is reused once
+  // that change has left the change log, so no logged diff can reach it
+  std::deque<std::pair<ChangeLog::Position, IdHandle> > m_releasedIds;
+
+  // per-id scratch for the diff walks, NO_SEQ everywhere between calls
+  mutable std::vector<uint64_t> m_scratchSeq;
+  mutable std::vector<IdHandle> m_scratchIds;
 }; // Class SyncState
 
 
@@ -0,0 +1,304 @@
+/* -*-  Mode: C++; c-file-style: "gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2014 Harbin Institute of Technology, China
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ * Author: Yu Zhang <yuzhang@hit.edu.cn>
+ */
+
+// timer-wheel.h
+
+#ifndef _TIMER_WHEEL_H
+#define _TIMER_WHEEL_H
+
+#include "ns3/assert.h"
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+namespace ns3 {
+namespace ndn {
+
+/// ========== Class TimerWheel ============
+
+/**
+ * @brief Hierarchical timing wheel counting in abstract ticks
+ *
+ * LEVELS wheels of SLOTS slots each; level l holds the timers due between
+ * SLOTS^l and SLOTS^(l+1) ticks from now, in the slot given by the
+ * matching bits of their expiry tick.  Every SLOTS^l ticks the current
+ * slot of level l is emptied into the lower levels, so a timer is moved
+ * at most LEVELS - 1 times before it expires.  Timers further out than
+ * the top level wait in its last slot and are placed again when it comes
+ * round.
+ *
+ * Schedule and Cancel are O(1): timers live in a pool and are linked into
+ * their slot by index, and a cancelled or expired timer goes back to the
+ * pool.  A handle carries the generation of its pool entry, so cancelling
+ * a timer that already expired is harmless.  The wheel has no notion of
+ * time; its owner calls Advance once per tick.
+ */
+template<class T>
+class TimerWheel {
+
+public:
+  typedef uint64_t Handle;
+
+  static const Handle NO_TIMER = 0;
+  static const uint32_t SLOT_BITS = 6;
+  static const uint32_t SLOTS = 1 << SLOT_BITS;
+  static const uint32_t LEVELS = 4;  // 2^24 ticks: 194 days of 1 s ticks
+
+  TimerWheel ()
+  : m_tick (0), m_size (0), m_free (NONE)
+  {
+    for (uint32_t level = 0; level < LEVELS; level++) {
+      for (uint32_t slot = 0; slot < SLOTS; slot++) {
+        m_slots[level][slot] = NONE;
+      }
+    }
+  }
+
+  /// Number of ticks Advance has moved on since construction
+  uint64_t
+  GetTick () const
+  {
+    return m_tick;
+  }
+
+  uint32_t
+  Size () const
+  {
+    return m_size;
+  }
+
+  bool
+  Empty () const
+  {
+    return m_size == 0;
+  }
+
+  /**
+   * @brief Arm a timer that expires ticks ticks from now (at least one)
+   */
+  Handle
+  Schedule (uint64_t ticks, const T & value)
+  {
+    uint32_t index = Allocate ();
+    Timer & timer = m_timers[index];
+    timer.expiry = m_tick + std::max<uint64_t> (ticks, 1);
+    timer.value = value;
+    Link (index);
+    m_size++;
+    return MakeHandle (index, timer.generation);
+  }
+
+  /// @returns false if handle already expired or was cancelled
+  bool
+  Cancel (Handle handle)
+  {
+    uint32_t index;
+    if (!Find (handle, index)) {
+      return false;
+    }
+    Unlink (index);
+    Release (index);
+    m_size--;
+    return true;
+  }
+
+  bool
+  IsPending (Handle handle) const
+  {
+    uint32_t index;
+    return Find (handle, index);
+  }
+
+  /**
+   * @brief Move on by ticks, appending the values of the timers that
+   *        expire to expired, earliest first
+   */
+  void
+  Advance (uint64_t ticks, std::vector<T> & expired)
+  {
+    for (; ticks > 0; ticks--) {
+      if (m_size == 0) {  // nothing to cascade or expire on the way
+        m_tick += ticks;
+        return;
+      }
+      m_tick++;
+
+      // bring down the timers of the coarser slots that come round now,
+      // highest level first so that they can fall through to level 0
+      for (uint32_t level = LEVELS - 1; level > 0; level--) {
+        if ((m_tick & ((uint64_t (1) << (level * SLOT_BITS)) - 1)) == 0) {
+          Cascade (level, SlotIndex (m_tick, level));
+        }
+      }
+
+      uint32_t & head = m_slots[0][SlotIndex (m_tick, 0)];
+      while (head != NONE) {
+        uint32_t index = head;
+        NS_ASSERT (m_timers[index].expiry <= m_tick);
+        Unlink (index);
+        expired.push_back (m_timers[index].value);
+        Release (index);
+        m_size--;
+      }
+    }
+  }
+
+private:
+  static const uint32_t NONE = 0xFFFFFFFF;
+
+  struct Timer
+  {
+    uint64_t expiry;
+    T value;
+    uint32_t generation;  // bumped every time the entry is released
+    uint32_t level;
+    uint32_t slot;
+    uint32_t prev;
+    uint32_t next;        // also links the free entries
+    bool active;
+
+    Timer ()
+    : expiry (0), value (), generation (1), level (0), slot (0), prev (NONE), next (NONE), active (false)
+    {}
+  };
+
+  static uint32_t
+  SlotIndex (uint64_t tick, uint32_t level)
+  {
+    return (tick >> (level * SLOT_BITS)) & (SLOTS - 1);
+  }
+
+  static Handle
+  MakeHandle (uint32_t index, uint32_t generation)
+  {
+    return (uint64_t (generation) << 32) | index;
+  }
+
+  bool
+  Find (Handle handle, uint32_t & index) const
+  {
+    index = handle & 0xFFFFFFFF;
+    return handle != NO_TIMER &&
+           index < m_timers.size () &&
+           m_timers[index].active &&
+           m_timers[index].generation == (handle >> 32);
+  }
+
+  uint32_t
+  Allocate ()
+  {
+    uint32_t index;
+    if (m_free != NONE) {
+      index = m_free;
+      m_free = m_timers[index].next;
+    } else {
+      index = m_timers.size ();
+      m_timers.push_back (Timer ());
+    }
+    m_timers[index].active = true;
+    return index;
+  }
+
+  void
+  Release (uint32_t index)
+  {
+    Timer & timer = m_timers[index];
+    timer.active = false;
+    timer.value = T ();
+    timer.generation++;
+    timer.next = m_free;
+    m_free = index;
+  }
+
+  // put the timer in the slot its expiry falls into, seen from m_tick; a
+  // timer cascaded down in its expiry tick lands in the slot about to expire
+  void
+  Link (uint32_t index)
+  {
+    Timer & timer = m_timers[index];
+    NS_ASSERT (timer.expiry >= m_tick);
+    uint64_t delta = timer.expiry - m_tick;
+    uint64_t expiry = timer.expiry;
+
+    uint32_t level = 0;
+    while (level < LEVELS - 1 && delta >= (uint64_t (1) << ((level + 1) * SLOT_BITS))) {
+      level++;
+    }
+    uint64_t range = uint64_t (1) << (LEVELS * SLOT_BITS);
+    if (delta >= range) {
+      // beyond the top level: the furthest slot, placed again from there
+      expiry = m_tick + range - 1;
+    }
+
+    timer.level = level;
+    timer.slot = SlotIndex (expiry, level);
+    uint32_t & head = m_slots[timer.level][timer.slot];
+    timer.prev = NONE;
+    timer.next = head;
+    if (head != NONE) {
+      m_timers[head].prev = index;
+    }
+    head = index;
+  }
+
+  void
+  Unlink (uint32_t index)
+  {
+    Timer & timer = m_timers[index];
+    if (timer.prev != NONE) {
+      m_timers[timer.prev].next = timer.next;
+    } else {
+      m_slots[timer.level][timer.slot] = timer.next;
+    }
+    if (timer.next != NONE) {
+      m_timers[timer.next].prev = timer.prev;
+    }
+    timer.prev = NONE;
+    timer.next = NONE;
+  }
+
+  void
+  Cascade (uint32_t level, uint32_t slot)
+  {
+    uint32_t index = m_slots[level][slot];
+    m_slots[level][slot] = NONE;
+    while (index != NONE) {
+      uint32_t next = m_timers[index].next;
+      Link (index);
+      index = next;
+    }
+  }
+
+private:
+  uint64_t m_tick;
+  uint32_t m_size;
+  std::vector<Timer> m_timers;
+  uint32_t m_free;  // head of the free entries of m_timers
+  uint32_t m_slots[LEVELS][SLOTS];
+}; // Class TimerWheel
+
+template<class T>
+const typename TimerWheel<T>::Handle TimerWheel<T>::NO_TIMER;
+
+} // namespace ndn
+} // namespace ns3
+
+#endif /* _TIMER_WHEEL_H */